@@ -1,10 +1,393 @@
 #include "oopp/precompiled.h"
+#include "oopp/cache.h"
 #include "oopp/dataframe.h"
+#include "oopp/profile.h"
+#include "oopp/scoring.h"
+#include "oopp/serve.h"
+#include "oopp/state.h"
 #include "oopp/timer.h"
 #include "classify_cmd.h"
 #include "oopp.h"
 
-const std::string usage {"classify [options] < fn.csv"};
+const std::string usage {"classify [options] < fn.csv | classify [options] --batch=filenames.txt --output-dir=dir | classify [options] --serve [--socket=path]"};
+
+// Read photons, checking for manual labels if they will be scored
+template<typename P>
+std::vector<oopp::photon> read_photons (std::istream &is, const bool score, P &prof)
+{
+    using namespace std;
+    using namespace oopp;
+
+    dataframe::dataframe df;
+    {
+        OOPP_TRACE_SPAN ("read");
+        auto s = prof.start ("read", 0);
+        df = dataframe::read_buffered (is);
+        s.set_photons (df.rows ());
+    }
+
+    bool has_manual_label = false;
+    bool has_predictions = false;
+    auto p = prof.run ("convert", df.rows (), [&] {
+        return dataframe::convert_dataframe (df, has_manual_label, has_predictions, string ()); });
+
+    if (score && !has_manual_label)
+        throw runtime_error ("Dataframe does NOT contain manual labels");
+
+    return p;
+}
+
+// Open the per-file scores CSV, if one was requested
+std::ofstream open_csv (const oopp::cmd::args &args)
+{
+    using namespace std;
+
+    ofstream ofs;
+    if (args.csv_filename.empty ())
+        return ofs;
+
+    if (args.verbose)
+        clog << "Writing CSV data to " << args.csv_filename << endl;
+
+    ofs.open (args.csv_filename);
+
+    if (!ofs)
+        throw runtime_error ("Could not open file for writing");
+
+    ofs << oopp::scoring::get_file_header () << endl;
+
+    return ofs;
+}
+
+// Open the prediction cache, if one was requested
+std::unique_ptr<oopp::cache::cache> open_cache (const oopp::cmd::args &args)
+{
+    using namespace std;
+
+    if (args.cache_dir.empty ())
+        return nullptr;
+
+    if (args.verbose)
+        clog << "Using the cache in " << args.cache_dir << endl;
+
+    return make_unique<oopp::cache::cache> (args.cache_dir, static_cast<uintmax_t> (args.cache_size) << 20);
+}
+
+// Save predictions in the cache. They are still good when they can't
+// be saved, so a failure is only reported.
+template<typename T>
+void put_cached (oopp::cache::cache &c, const std::string &key, const T &p)
+{
+    using namespace std;
+
+    try
+    {
+        c.put (key, p);
+    }
+    catch (const exception &e)
+    {
+        clog << "cache: " << e.what () << endl;
+    }
+}
+
+void print_cache_stats (std::ostream &os, const oopp::cache::cache &c)
+{
+    os << "cache: "
+        << c.hits () << " hits, "
+        << c.misses () << " misses, "
+        << c.evictions () << " evictions"
+        << std::endl;
+}
+
+// Classify a list of files in a single process
+void classify_files (const oopp::cmd::args &args)
+{
+    using namespace std;
+    using namespace oopp;
+
+    const auto filenames = cmd::read_filenames (args.batch);
+
+    if (args.verbose)
+        clog << filenames.size () << " filenames read" << endl;
+
+    // Start a timer
+    timer::timer t0;
+
+    // Exceptions can't leave a parallel region, so save them here
+    vector<string> errors (filenames.size ());
+
+    // Read the points
+    vector<vector<photon>> tracks (filenames.size ());
+    vector<double> seconds (filenames.size ());
+
+    // Start the largest files first, and hand them out one at a time
+    const auto order = cmd::get_largest_first (filenames);
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < order.size (); ++k)
+    {
+        const size_t i = order[k];
+        try
+        {
+            timer::timer t;
+
+            ifstream ifs (filenames[i]);
+            if (!ifs)
+                throw runtime_error ("Could not open file for reading");
+
+            profile::null_profiler prof;
+            tracks[i] = read_photons (ifs, args.score, prof);
+            seconds[i] = t.elapsed_ns () / 1'000'000'000;
+        }
+        catch (const exception &e)
+        {
+            errors[i] = filenames[i] + ": " + e.what ();
+        }
+    }
+
+    for (const auto &e : errors)
+        if (!e.empty ())
+            throw runtime_error (e);
+
+    size_t total_photons = 0;
+    for (const auto &p : tracks)
+        total_photons += p.size ();
+
+    if (args.verbose)
+    {
+        clog << total_photons << " points read" << endl;
+        clog << "Classifying points" << endl;
+    }
+
+    // Start a timer
+    timer::timer t1;
+
+    // Look for the predictions in the cache
+    const auto c = open_cache (args);
+    vector<string> keys (filenames.size ());
+    vector<char> cached (filenames.size (), 0);
+
+    if (c)
+    {
+#pragma omp parallel for schedule(dynamic)
+        for (size_t k = 0; k < order.size (); ++k)
+        {
+            const size_t i = order[k];
+            keys[i] = cache::get_key (tracks[i], args.oo_params);
+            cached[i] = c->get (keys[i], tracks[i]);
+        }
+    }
+
+    // Classify the rest of the tracks at once
+    vector<size_t> misses;
+    for (size_t i = 0; i < tracks.size (); ++i)
+        if (!cached[i])
+            misses.push_back (i);
+
+    vector<vector<photon>> tmp (misses.size ());
+    for (size_t j = 0; j < misses.size (); ++j)
+        tmp[j] = move (tracks[misses[j]]);
+
+    tmp = classify_batch (move (tmp), args.oo_params);
+
+    for (size_t j = 0; j < misses.size (); ++j)
+        tracks[misses[j]] = move (tmp[j]);
+
+    if (c)
+    {
+#pragma omp parallel for schedule(dynamic)
+        for (size_t j = 0; j < misses.size (); ++j)
+        {
+            const size_t i = misses[j];
+            put_cached (*c, keys[i], tracks[i]);
+        }
+    }
+
+    // Time the classification only
+    t1.stop ();
+
+    // Write classified output, largest first
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < order.size (); ++k)
+    {
+        const size_t i = order[k];
+        if (args.output_dir.empty ())
+            continue;
+
+        OOPP_TRACE_SPAN ("write");
+
+        const auto stem = filesystem::path (filenames[i]).stem ().string ();
+        const auto fn = filesystem::path (args.output_dir) / (stem + "_classified.csv");
+        ofstream ofs (fn);
+        if (!ofs)
+        {
+            errors[i] = fn.string () + ": Could not open file for writing";
+            continue;
+        }
+        write_predictions (ofs, tracks[i]);
+    }
+
+    for (const auto &e : errors)
+        if (!e.empty ())
+            throw runtime_error (e);
+
+    if (args.score)
+    {
+        using namespace oopp::scoring;
+
+        const auto classes = get_classes (args.cls);
+
+        // Each file gets its own slot, so the loop needs no synchronization
+        vector<string> rows (filenames.size ());
+        auto m = get_multiclass_confusion_matrix (classes);
+
+#pragma omp parallel for schedule(dynamic) reduction(+:m)
+        for (size_t k = 0; k < order.size (); ++k)
+        {
+            const size_t i = order[k];
+            OOPP_TRACE_SPAN ("score");
+            timer::timer t;
+
+            size_t ignored;
+            const auto cm = get_multiclass_confusion_matrix (tracks[i], classes, args.ignore_cls, ignored);
+            m.add (cm);
+
+            // Classification is shared by all files, so the per-file
+            // time only covers reading and scoring
+            if (!args.csv_filename.empty ())
+                rows[i] = print_file (get_confusion_matrices (cm),
+                    "oopp",
+                    filenames[i],
+                    tracks[i].size (),
+                    seconds[i] + t.elapsed_ns () / 1'000'000'000);
+        }
+
+        // Write the per-file results in input order
+        auto ofs = open_csv (args);
+        for (const auto &r : rows)
+            ofs << r;
+
+        const auto results = print_results (get_confusion_matrices (m), args.cls == -1);
+
+        if (args.verbose)
+            clog << results;
+
+        cout << results;
+    }
+
+    // Time classification and I/O
+    t0.stop ();
+
+    if (!args.trace.empty ())
+    {
+        if (args.verbose)
+            clog << "Writing trace to " << args.trace << endl;
+
+        trace::write_chrome_trace (args.trace);
+    }
+
+    // Write out performance stats
+    if (args.verbose)
+    {
+        const double s0 = t0.elapsed_ns () / 1'000'000'000;
+        const double s1 = t1.elapsed_ns () / 1'000'000'000;
+        const size_t pps0 = (s0 == 0.0) ? 0.0 : total_photons / s0;
+        const size_t pps1 = (s1 == 0.0) ? 0.0 : total_photons / s1;
+        clog.imbue (std::locale (""));
+        clog << fixed;
+        clog << setprecision(3);
+        clog << filenames.size () << " files" << endl;
+        clog << total_photons << " photons" << endl;
+        clog << s0 << "/" << s1 << " total/process seconds" << endl;
+        clog << pps0 << "/" << pps1 << " total/process photons/second" << endl;
+        if (c)
+            print_cache_stats (clog, *c);
+    }
+}
+
+// Classify tracks sent by clients until stdin ends, or forever on a socket
+//
+// The process, its OpenMP threads and its cache stay up between
+// requests, so small tracks don't pay for starting them.
+void serve_tracks (const oopp::cmd::args &args)
+{
+    using namespace std;
+    using namespace oopp;
+
+    // A client that hangs up should not stop the server
+    signal (SIGPIPE, SIG_IGN);
+
+    const auto c = open_cache (args);
+    const uint64_t max_payload = static_cast<uint64_t> (args.max_request_size) << 20;
+
+    const auto f = [&](vector<photon> &p)
+    {
+        timer::timer t;
+
+        string key;
+        bool cached = false;
+        if (c)
+        {
+            key = cache::get_key (p, args.oo_params);
+            cached = c->get (key, p);
+        }
+
+        if (!cached)
+        {
+            p = classify (move (p), args.oo_params);
+            if (c)
+                put_cached (*c, key, p);
+        }
+
+        if (args.verbose)
+            clog << p.size () << " photons in "
+                << t.elapsed_ns () / 1'000'000'000 << " seconds"
+                << (cached ? ", cached" : "") << endl;
+    };
+
+    if (args.socket.empty ())
+    {
+        if (args.verbose)
+            clog << "Serving on stdin" << endl;
+
+        const auto n = serve::serve (STDIN_FILENO, STDOUT_FILENO, f, max_payload);
+
+        if (args.verbose)
+            clog << n << " requests served" << endl;
+
+        return;
+    }
+
+    const int fd = serve::listen (args.socket);
+
+    if (args.verbose)
+        clog << "Serving on " << args.socket << endl;
+
+    while (true)
+    {
+        const int conn = accept (fd, nullptr, nullptr);
+        if (conn == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            throw runtime_error ("Could not accept a connection");
+        }
+
+        // A client that breaks the protocol or stalls only loses its
+        // own connection
+        try
+        {
+            serve::set_timeout (conn, args.timeout);
+            serve::serve (conn, conn, f, max_payload);
+        }
+        catch (const exception &e)
+        {
+            clog << e.what () << endl;
+        }
+
+        close (conn);
+    }
+}
 
 int main (int argc, char **argv)
 {
@@ -25,17 +408,32 @@ int main (int argc, char **argv)
             // Show the args
             clog << "cmd_line_parameters:" << endl;
             clog << args;
-            clog << "Reading dataframe from stdin" << endl;
         }
 
+        if (!args.batch.empty ())
+        {
+            classify_files (args);
+            return 0;
+        }
+
+        if (args.serve)
+        {
+            serve_tracks (args);
+            return 0;
+        }
+
+        if (args.verbose)
+            clog << "Reading dataframe from stdin" << endl;
+
         // Start a timer
         timer::timer t0;
 
-        // Read the points
-        const auto df = dataframe::read_buffered (cin);
+        // Record each stage, and count allocations if asked to
+        profile::profiler prof;
+        profile::count_allocations (args.verbose || !args.profile.empty ());
 
-        // Convert it to the correct format
-        auto p = convert_dataframe (df);
+        // Read the points
+        auto p = read_photons (cin, args.score, prof);
 
         if (args.verbose)
         {
@@ -53,8 +451,56 @@ int main (int argc, char **argv)
         // Start a timer
         timer::timer t1;
 
+        // Look for the predictions in the cache
+        const auto c = open_cache (args);
+        string key;
+        bool cached = false;
+
+        if (c)
+        {
+            [[maybe_unused]] const auto s = prof.start ("cache_get", p.size ());
+            key = cache::get_key (p, args.oo_params);
+            cached = c->get (key, p);
+        }
+
         // Classify the points
-        p = classify (p, args.oo_params);
+        if (cached)
+        {
+            if (args.verbose)
+                clog << "Found the predictions in the cache" << endl;
+        }
+        else if (!args.load_state.empty ())
+        {
+            if (args.verbose)
+                clog << "Reading state from " << args.load_state << endl;
+
+            // Only recompute the threshold-dependent stages
+            const auto s = state::read (args.load_state);
+            p = prof.run ("classify", p.size (), [&] {
+                return state::classify (p, s, args.oo_params); });
+        }
+        else if (!args.save_state.empty ())
+        {
+            const auto s = prof.run ("get_state", p.size (), [&] {
+                return state::get_track (p, args.oo_params); });
+
+            if (args.verbose)
+                clog << "Writing state to " << args.save_state << endl;
+
+            state::write (args.save_state, s);
+            p = prof.run ("classify", p.size (), [&] {
+                return state::classify (p, s, args.oo_params); });
+        }
+        else
+        {
+            p = classify (move (p), args.oo_params, prof);
+        }
+
+        if (c && !cached)
+        {
+            [[maybe_unused]] const auto s = prof.start ("cache_put", p.size ());
+            put_cached (*c, key, p);
+        }
 
         // Time the classification only
         t1.stop ();
@@ -68,15 +514,72 @@ int main (int argc, char **argv)
             ((void) (i)); // Eliminate unused variable warning
         }
 
-        // Write classified output to stdout
-        write_predictions (cout, p);
+        if (args.score)
+        {
+            using namespace oopp::scoring;
+
+            // Score straight from the classified photons
+            size_t ignored;
+            const auto m = prof.run ("score", p.size (), [&] {
+                return get_multiclass_confusion_matrix (p, get_classes (args.cls), args.ignore_cls, ignored); });
+
+            auto ofs = open_csv (args);
+            ofs << print_file (get_confusion_matrices (m), "oopp", "-", p.size (), t1.elapsed_ns () / 1'000'000'000);
+
+            if (!args.predictions.empty ())
+            {
+                ofstream pofs (args.predictions);
+                if (!pofs)
+                    throw runtime_error ("Could not open file for writing");
+                [[maybe_unused]] const auto s = prof.start ("write", p.size ());
+                write_predictions (pofs, p);
+            }
+
+            const auto results = print_results (get_confusion_matrices (m), args.cls == -1);
+
+            if (args.verbose)
+                clog << results;
+
+            // Write scores to stdout
+            cout << results;
+        }
+        else
+        {
+            // Write classified output to stdout
+            [[maybe_unused]] const auto s = prof.start ("write", p.size ());
+            OOPP_TRACE_SPAN ("write");
+            write_predictions (cout, p);
+        }
 
         // Time classification and I/O
         t0.stop ();
 
+        if (!args.trace.empty ())
+        {
+            if (args.verbose)
+                clog << "Writing trace to " << args.trace << endl;
+
+            trace::write_chrome_trace (args.trace);
+        }
+
+        profile::count_allocations (false);
+
+        if (!args.profile.empty ())
+        {
+            if (args.verbose)
+                clog << "Writing profile to " << args.profile << endl;
+
+            ofstream ofs (args.profile);
+            if (!ofs)
+                throw runtime_error ("Could not open file for writing");
+            profile::write_json (ofs, prof);
+        }
+
         // Write out performance stats
         if (args.verbose)
         {
+            profile::write_table (clog, prof);
+
             const double e0 = t0.elapsed_ns ();
             const double e1 = t1.elapsed_ns ();
             const double s0 = (e0 == 0.0) ? 0.0 : e0 / 1'000'000'000;
@@ -89,6 +592,8 @@ int main (int argc, char **argv)
             clog << p.size () << " photons" << endl;
             clog << s0 << "/" << s1 << " total/process seconds" << endl;
             clog << pps0 << "/" << pps1 << " total/process photons/second" << endl;
+            if (c)
+                print_cache_stats (clog, *c);
         }
 
         return 0;
@@ -0,0 +1,107 @@
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/serve.h"
+#include "oopp/timer.h"
+#include "classify_client_cmd.h"
+#include "oopp.h"
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"classify_client [options] --socket=path < fn.csv > fn_classified.csv"};
+
+// Send a request and wait for its response
+serve::frame send (const int fd, const uint32_t type, const string &payload)
+{
+    serve::write_frame (fd, type, payload);
+
+    // Predictions are larger than the track they were made from, so
+    // the server's request size limit doesn't apply to its responses
+    serve::frame response;
+    if (!serve::read_frame (fd, response, numeric_limits<uint64_t>::max ()))
+        throw runtime_error ("The server closed the connection");
+
+    if (response.type == serve::ERROR)
+        throw runtime_error ("Server error: " + response.payload);
+
+    if (response.type != type)
+        throw runtime_error ("Unexpected response type " + to_string (response.type));
+
+    return response;
+}
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        // Parse the args
+        const auto args = cmd::get_args (argc, argv, usage);
+
+        // If you are getting help, exit without an error
+        if (args.help)
+            return 0;
+
+        if (args.verbose)
+        {
+            // Show the args
+            clog << "cmd_line_parameters:" << endl;
+            clog << args;
+        }
+
+        // Read the track
+        const string csv { istreambuf_iterator<char> (cin), istreambuf_iterator<char> () };
+
+        vector<photon> p;
+        string payload = csv;
+        if (args.binary)
+        {
+            istringstream is (csv);
+            p = dataframe::convert_dataframe (dataframe::read_buffered (is));
+            payload = serve::encode_photons (p);
+        }
+
+        const uint32_t type = args.binary ? serve::BINARY : serve::CSV;
+
+        const int fd = serve::connect (args.socket);
+
+        // Send the request 'repeat' times on one connection
+        serve::frame response;
+        vector<double> seconds;
+        for (size_t i = 0; i < args.repeat; ++i)
+        {
+            timer::timer t;
+            response = send (fd, type, payload);
+            seconds.push_back (t.elapsed_ns () / 1'000'000'000);
+        }
+
+        close (fd);
+
+        // Write the predictions
+        if (args.binary)
+        {
+            serve::decode_predictions (response.payload, p);
+            write_predictions (cout, p);
+        }
+        else
+        {
+            cout << response.payload;
+        }
+
+        // Write out latencies
+        if (args.verbose)
+        {
+            sort (seconds.begin (), seconds.end ());
+            clog << fixed << setprecision (6);
+            clog << seconds.size () << " requests" << endl;
+            clog << seconds.front () << "/" << seconds[seconds.size () / 2] << "/" << seconds.back ()
+                << " min/median/max seconds per request" << endl;
+        }
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
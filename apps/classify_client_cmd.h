@@ -0,0 +1,85 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cmd_utils.h"
+
+namespace oopp
+{
+
+namespace cmd
+{
+
+struct args
+{
+    bool help = false;
+    bool verbose = false;
+    std::string socket;
+    bool binary = false;
+    size_t repeat = 1;
+};
+
+std::ostream &operator<< (std::ostream &os, const args &args)
+{
+    os << std::boolalpha;
+    os << "help: " << args.help << std::endl;
+    os << "verbose: " << args.verbose << std::endl;
+    os << "socket: '" << args.socket << "'" << std::endl;
+    os << "binary: " << args.binary << std::endl;
+    os << "repeat: " << args.repeat << std::endl;
+    return os;
+}
+
+args get_args (int argc, char **argv, const std::string &usage)
+{
+    args args;
+    while (1)
+    {
+        int option_index = 0;
+        static struct option long_options[] = {
+            {"help", no_argument, 0,  'h'},
+            {"verbose", no_argument, 0,  'v'},
+            {"socket", required_argument, 0,  's'},
+            {"binary", no_argument, 0,  'b'},
+            {"repeat", required_argument, 0,  'r'},
+            {0,      0,           0,  0 }
+        };
+
+        int c = getopt_long(argc, argv, "hvs:br:", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            default:
+            case 0:
+            case 'h':
+            {
+                const size_t noptions = sizeof (long_options) / sizeof (struct option);
+                cmd::print_help (std::clog, usage, noptions, long_options);
+                if (c != 'h')
+                    throw std::runtime_error ("Invalid option");
+                args.help = true;
+                return args;
+            }
+            case 'v': args.verbose = true; break;
+            case 's': args.socket = std::string (optarg); break;
+            case 'b': args.binary = true; break;
+            case 'r': args.repeat = atol(optarg); break;
+        }
+    }
+
+    // Check command line
+    if (optind != argc)
+        throw std::runtime_error ("Too many arguments on command line");
+
+    if (args.socket.empty ())
+        throw std::runtime_error ("No socket was specified");
+
+    if (args.repeat == 0)
+        throw std::runtime_error ("The number of repeats must be positive");
+
+    return args;
+}
+
+} // namespace cmd
+
+} // namespace oopp
@@ -3,6 +3,7 @@
 #include "oopp/precompiled.h"
 #include "oopp/cmd_utils.h"
 #include "oopp/oopp.h"
+#include "oopp/trace.h"
 
 namespace oopp
 {
@@ -14,6 +15,23 @@ struct args
 {
     bool help = false;
     bool verbose = false;
+    std::string save_state;
+    std::string load_state;
+    std::string batch;
+    std::string output_dir;
+    bool score = false;
+    std::string predictions;
+    std::string csv_filename;
+    int cls = -1;
+    int ignore_cls = -1;
+    std::string profile;
+    std::string trace;
+    std::string cache_dir;
+    size_t cache_size = 1024;
+    bool serve = false;
+    std::string socket;
+    size_t max_request_size = 1024;
+    double timeout = 60.0;
     oopp::params oo_params;
 };
 
@@ -22,6 +40,23 @@ std::ostream &operator<< (std::ostream &os, const args &args)
     os << std::boolalpha;
     os << "help: " << args.help << std::endl;
     os << "verbose: " << args.verbose << std::endl;
+    os << "save-state: '" << args.save_state << "'" << std::endl;
+    os << "load-state: '" << args.load_state << "'" << std::endl;
+    os << "batch: '" << args.batch << "'" << std::endl;
+    os << "output-dir: '" << args.output_dir << "'" << std::endl;
+    os << "score: " << args.score << std::endl;
+    os << "predictions: '" << args.predictions << "'" << std::endl;
+    os << "csv-filename: '" << args.csv_filename << "'" << std::endl;
+    os << "class: " << args.cls << std::endl;
+    os << "ignore-class: " << args.ignore_cls << std::endl;
+    os << "profile: '" << args.profile << "'" << std::endl;
+    os << "trace: '" << args.trace << "'" << std::endl;
+    os << "cache-dir: '" << args.cache_dir << "'" << std::endl;
+    os << "cache-size: " << args.cache_size << "MB" << std::endl;
+    os << "serve: " << args.serve << std::endl;
+    os << "socket: '" << args.socket << "'" << std::endl;
+    os << "max-request-size: " << args.max_request_size << "MB" << std::endl;
+    os << "timeout: " << args.timeout << "s" << std::endl;
     os << args.oo_params;
     return os;
 }
@@ -42,6 +77,24 @@ const int OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID = 1013;
 const int OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID = 1014;
 const int OO_SURFACE_N_STDDEV = 1015;
 const int OO_BATHY_N_STDDEV = 1016;
+const int OO_X_STRIDE = 1017;
+const int SAVE_STATE_ID = 2001;
+const int LOAD_STATE_ID = 2002;
+const int BATCH_ID = 2003;
+const int OUTPUT_DIR_ID = 2004;
+const int SCORE_ID = 2005;
+const int PREDICTIONS_ID = 2006;
+const int CSV_FILENAME_ID = 2007;
+const int CLASS_ID = 2008;
+const int IGNORE_CLASS_ID = 2009;
+const int PROFILE_ID = 2010;
+const int TRACE_ID = 2011;
+const int CACHE_DIR_ID = 2012;
+const int CACHE_SIZE_ID = 2013;
+const int SERVE_ID = 2014;
+const int SOCKET_ID = 2015;
+const int MAX_REQUEST_SIZE_ID = 2016;
+const int TIMEOUT_ID = 2017;
 
 args get_args (int argc, char **argv, const std::string &usage)
 {
@@ -52,6 +105,23 @@ args get_args (int argc, char **argv, const std::string &usage)
         static struct option long_options[] = {
             {"help", no_argument, 0,  'h'},
             {"verbose", no_argument, 0,  'v'},
+            {"save-state", required_argument, 0, SAVE_STATE_ID},
+            {"load-state", required_argument, 0, LOAD_STATE_ID},
+            {"batch", required_argument, 0, BATCH_ID},
+            {"output-dir", required_argument, 0, OUTPUT_DIR_ID},
+            {"score", no_argument, 0, SCORE_ID},
+            {"predictions", required_argument, 0, PREDICTIONS_ID},
+            {"csv-filename", required_argument, 0, CSV_FILENAME_ID},
+            {"class", required_argument, 0, CLASS_ID},
+            {"ignore-class", required_argument, 0, IGNORE_CLASS_ID},
+            {"profile", required_argument, 0, PROFILE_ID},
+            {"trace", required_argument, 0, TRACE_ID},
+            {"cache-dir", required_argument, 0, CACHE_DIR_ID},
+            {"cache-size", required_argument, 0, CACHE_SIZE_ID},
+            {"serve", no_argument, 0, SERVE_ID},
+            {"socket", required_argument, 0, SOCKET_ID},
+            {"max-request-size", required_argument, 0, MAX_REQUEST_SIZE_ID},
+            {"timeout", required_argument, 0, TIMEOUT_ID},
             {"oo-x-resolution", required_argument, 0, OO_X_RESOLUTION_ID},
             {"oo-z-resolution", required_argument, 0, OO_Z_RESOLUTION_ID},
             {"oo-z-min", required_argument, 0, OO_Z_MIN_ID},
@@ -68,6 +138,7 @@ args get_args (int argc, char **argv, const std::string &usage)
             {"oo-min-bathy-photons-per-window-id", required_argument, 0, OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID},
             {"oo-surface-n-stddev", required_argument, 0, OO_SURFACE_N_STDDEV},
             {"oo-bathy-n-stddev", required_argument, 0, OO_BATHY_N_STDDEV},
+            {"oo-x-stride", required_argument, 0, OO_X_STRIDE},
             {0,      0,           0,  0 }
         };
 
@@ -88,6 +159,23 @@ args get_args (int argc, char **argv, const std::string &usage)
                 return args;
             }
             case 'v': args.verbose = true; break;
+            case SAVE_STATE_ID: args.save_state = std::string (optarg); break;
+            case LOAD_STATE_ID: args.load_state = std::string (optarg); break;
+            case BATCH_ID: args.batch = std::string (optarg); break;
+            case OUTPUT_DIR_ID: args.output_dir = std::string (optarg); break;
+            case SCORE_ID: args.score = true; break;
+            case PREDICTIONS_ID: args.predictions = std::string (optarg); break;
+            case CSV_FILENAME_ID: args.csv_filename = std::string (optarg); break;
+            case CLASS_ID: args.cls = atol (optarg); break;
+            case IGNORE_CLASS_ID: args.ignore_cls = atol (optarg); break;
+            case PROFILE_ID: args.profile = std::string (optarg); break;
+            case TRACE_ID: args.trace = std::string (optarg); break;
+            case CACHE_DIR_ID: args.cache_dir = std::string (optarg); break;
+            case CACHE_SIZE_ID: args.cache_size = atol (optarg); break;
+            case SERVE_ID: args.serve = true; break;
+            case SOCKET_ID: args.socket = std::string (optarg); break;
+            case MAX_REQUEST_SIZE_ID: args.max_request_size = atol (optarg); break;
+            case TIMEOUT_ID: args.timeout = atof (optarg); break;
             case OO_X_RESOLUTION_ID: args.oo_params.x_resolution = atof (optarg); break;
             case OO_Z_RESOLUTION_ID: args.oo_params.z_resolution = atof (optarg); break;
             case OO_Z_MIN_ID: args.oo_params.z_min = atof (optarg); break;
@@ -104,6 +192,7 @@ args get_args (int argc, char **argv, const std::string &usage)
             case OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID: args.oo_params.min_bathy_photons_per_window = atol (optarg); break;
             case OO_SURFACE_N_STDDEV: args.oo_params.surface_n_stddev = atof (optarg); break;
             case OO_BATHY_N_STDDEV: args.oo_params.bathy_n_stddev = atof (optarg); break;
+            case OO_X_STRIDE: args.oo_params.x_stride = atof (optarg); break;
         }
     }
 
@@ -111,6 +200,46 @@ args get_args (int argc, char **argv, const std::string &usage)
     if (optind != argc)
         throw std::runtime_error ("Too many arguments on command line");
 
+    if (!args.save_state.empty () && !args.load_state.empty ())
+        throw std::runtime_error ("Can't both save and load state");
+
+    // When scoring, predictions are only written if asked for
+    if (args.batch.empty () && !args.output_dir.empty ())
+        throw std::runtime_error ("--output-dir requires --batch");
+
+    if (!args.batch.empty () && args.output_dir.empty () && !args.score)
+        throw std::runtime_error ("--batch requires --output-dir or --score");
+
+    if (!args.score && (!args.predictions.empty () || !args.csv_filename.empty ()))
+        throw std::runtime_error ("--predictions and --csv-filename require --score");
+
+    if (!args.trace.empty () && !trace::enabled ())
+        throw std::runtime_error ("This build does not record traces, configure it with -DOOPP_TRACE=ON");
+
+    if (!args.batch.empty () && !args.profile.empty ())
+        throw std::runtime_error ("Can't profile in batch mode");
+
+    if (!args.batch.empty () && !args.predictions.empty ())
+        throw std::runtime_error ("Use --output-dir to write predictions in batch mode");
+
+    if (!args.batch.empty () && (!args.save_state.empty () || !args.load_state.empty ()))
+        throw std::runtime_error ("Can't save or load state in batch mode");
+
+    if (!args.cache_dir.empty () && (!args.save_state.empty () || !args.load_state.empty ()))
+        throw std::runtime_error ("Can't save or load state with a cache");
+
+    if (!args.serve && !args.socket.empty ())
+        throw std::runtime_error ("--socket requires --serve");
+
+    if (args.timeout < 0.0)
+        throw std::runtime_error ("--timeout can't be negative");
+
+    if (args.serve && (!args.batch.empty () || args.score || !args.profile.empty ()))
+        throw std::runtime_error ("Can't serve in batch, score or profile mode");
+
+    if (args.serve && (!args.save_state.empty () || !args.load_state.empty ()))
+        throw std::runtime_error ("Can't save or load state when serving");
+
     return args;
 }
 
@@ -0,0 +1,350 @@
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/profile.h"
+#include "oopp/scaling.h"
+#include "oopp/synthetic.h"
+#include "oopp/timer.h"
+#include "scaling_cmd.h"
+#include "oopp.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"scaling [options] [filename1.csv filename2.csv ...]"};
+
+// Seconds per stage of one run, and in total
+using stage_times = map<string,double>;
+
+/// @brief Classify tracks one after another
+/// @param tracks Tracks
+/// @param workload Indexes into 'tracks', which may repeat
+/// @param threads Number of threads used for each track
+/// @param repeats Number of runs, the fastest is returned
+stage_times run_tracks (const vector<vector<photon>> &tracks,
+    const vector<size_t> &workload,
+    const size_t threads,
+    const size_t repeats)
+{
+    const params params;
+
+    omp_set_num_threads (threads);
+
+    stage_times best { { "total", numeric_limits<double>::max () } };
+    for (size_t i = 0; i < repeats; ++i)
+    {
+        profile::profiler prof;
+        timer::timer t;
+        for (auto j : workload)
+            classify (tracks[j], params, prof);
+        t.stop ();
+
+        const double total = t.elapsed_ns () / 1'000'000'000;
+        if (total >= best["total"])
+            continue;
+
+        best.clear ();
+        best["total"] = total;
+        for (const auto &s : prof.get_stages ())
+            best[s.name] += s.seconds;
+    }
+
+    return best;
+}
+
+// Start a classify process that reads a file and discards its output
+pid_t spawn_classify (const string &classify, const string &fn, char **envp)
+{
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init (&fa);
+    posix_spawn_file_actions_addopen (&fa, 0, fn.c_str (), O_RDONLY, 0);
+    posix_spawn_file_actions_addopen (&fa, 1, "/dev/null", O_WRONLY, 0);
+
+    string cmd (classify);
+    char *argv[] = { cmd.data (), nullptr };
+    pid_t pid;
+    const int rc = posix_spawn (&pid, classify.c_str (), &fa, nullptr, argv, envp);
+    posix_spawn_file_actions_destroy (&fa);
+
+    if (rc != 0)
+        throw runtime_error ("Could not start " + classify);
+
+    return pid;
+}
+
+/// @brief Classify files in concurrent processes, like 'make classify'
+/// @param classify Path of the classify app
+/// @param filenames Input files, one process each
+/// @param processes Number of processes that run at once
+/// @param threads OMP_NUM_THREADS of each process
+/// @param repeats Number of runs, the fastest is returned
+///
+/// The times include starting the processes and reading and writing
+/// CSV, as they do when classifying with GNU parallel.
+double run_split (const string &classify,
+    const vector<string> &filenames,
+    const size_t processes,
+    const size_t threads,
+    const size_t repeats)
+{
+    // Each process gets this environment, with its own thread count
+    vector<string> env;
+    for (char **i = environ; *i != nullptr; ++i)
+        if (string (*i).rfind ("OMP_NUM_THREADS=", 0) != 0)
+            env.push_back (*i);
+    env.push_back ("OMP_NUM_THREADS=" + to_string (threads));
+    vector<char *> envp;
+    for (auto &i : env)
+        envp.push_back (i.data ());
+    envp.push_back (nullptr);
+
+    double best = numeric_limits<double>::max ();
+    for (size_t i = 0; i < repeats; ++i)
+    {
+        timer::timer t;
+        size_t next = 0;
+        size_t running = 0;
+        bool failed = false;
+        while (next < filenames.size () || running != 0)
+        {
+            if (next < filenames.size () && running < processes && !failed)
+            {
+                spawn_classify (classify, filenames[next++], envp.data ());
+                ++running;
+                continue;
+            }
+
+            // Stop starting processes after a failure, but wait for
+            // the ones that are running
+            if (failed && running == 0)
+                break;
+
+            int status;
+            if (wait (&status) == -1)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw runtime_error ("Could not wait for classify");
+            }
+            --running;
+            failed = failed || !WIFEXITED (status) || WEXITSTATUS (status) != 0;
+        }
+        t.stop ();
+
+        if (failed)
+            throw runtime_error (classify + " failed");
+
+        best = min (best, t.elapsed_ns () / 1'000'000'000);
+    }
+
+    return best;
+}
+
+// Files for the split study, removed when they go out of scope
+struct temp_files
+{
+    filesystem::path dir;
+    vector<string> filenames;
+    temp_files ()
+        : dir (filesystem::temp_directory_path () / ("scaling_" + to_string (getpid ())))
+    {
+        filesystem::create_directories (dir);
+    }
+    ~temp_files ()
+    {
+        error_code ec;
+        filesystem::remove_all (dir, ec);
+    }
+};
+
+void print_header ()
+{
+    cout << "study"
+        << "\t" << "processes"
+        << "\t" << "threads"
+        << "\t" << "stage"
+        << "\t" << "seconds"
+        << "\t" << "photons_per_second"
+        << "\t" << "speedup"
+        << "\t" << "efficiency"
+        << "\t" << "serial_fraction"
+        << endl;
+}
+
+/// @brief Print one row
+/// @param s Speedup
+/// @param p Number of cores used
+void print (const string &study,
+    const size_t processes,
+    const size_t threads,
+    const string &stage,
+    const double seconds,
+    const size_t photons,
+    const double s,
+    const size_t p)
+{
+    cout << study
+        << "\t" << processes
+        << "\t" << threads
+        << "\t" << stage
+        << "\t" << fixed << setprecision (6) << seconds
+        << "\t" << setprecision (0) << (seconds == 0.0 ? 0.0 : photons / seconds)
+        << "\t" << setprecision (3) << s
+        << "\t" << scaling::efficiency (s, p)
+        << "\t" << scaling::serial_fraction (s, p)
+        << endl;
+}
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        // Parse the args
+        auto args = cmd::get_args (argc, argv, usage);
+
+        // If you are getting help, exit without an error
+        if (args.help)
+            return 0;
+
+        if (args.threads.empty ())
+            args.threads = scaling::get_thread_counts (args.cores);
+
+        // Speedups are relative to one thread, so that goes first
+        args.threads.push_back (1);
+        sort (args.threads.begin (), args.threads.end ());
+        args.threads.erase (unique (args.threads.begin (), args.threads.end ()), args.threads.end ());
+
+        if (args.verbose)
+        {
+            // Show the args
+            clog << "cmd_line_parameters:" << endl;
+            clog << args;
+        }
+
+        // Read the tracks
+        vector<vector<photon>> tracks;
+        for (const auto &fn : args.filenames)
+        {
+            if (args.verbose)
+                clog << "Reading " << fn << endl;
+
+            tracks.push_back (dataframe::convert_dataframe (dataframe::read_buffered (fn)));
+        }
+
+        // Add synthetic tracks. The split study's processes read them
+        // from files.
+        temp_files synthetic_files;
+        for (size_t i = 0; i < args.tracks; ++i)
+        {
+            synthetic::track_params tp;
+            tp.length = args.synthetic / tp.density;
+            tp.seed = i;
+            tracks.push_back (synthetic::get_track (tp));
+
+            if (!args.splits)
+                continue;
+
+            const auto fn = (synthetic_files.dir / ("synthetic_" + to_string (i) + ".csv")).string ();
+            ofstream ofs (fn);
+            write_predictions (ofs, tracks.back ());
+            if (!ofs)
+                throw runtime_error ("Could not write " + fn);
+            synthetic_files.filenames.push_back (fn);
+        }
+
+        size_t photons = 0;
+        vector<size_t> all (tracks.size ());
+        for (size_t i = 0; i < tracks.size (); ++i)
+        {
+            photons += tracks[i].size ();
+            all[i] = i;
+        }
+
+        if (args.verbose)
+            clog << tracks.size () << " tracks, " << photons << " photons" << endl;
+
+        print_header ();
+
+        // Strong scaling: the same tracks on more threads
+        stage_times t1;
+        if (args.strong)
+            t1 = run_tracks (tracks, all, 1, args.repeats);
+
+        if (args.strong)
+        {
+            for (auto p : args.threads)
+            {
+                if (args.verbose)
+                    clog << "Strong scaling on " << p << " threads" << endl;
+
+                const auto tp = p == 1 ? t1 : run_tracks (tracks, all, p, args.repeats);
+                for (const auto &i : tp)
+                    print ("strong", 1, p, i.first, i.second, photons,
+                        scaling::speedup (t1[i.first], i.second), p);
+            }
+        }
+
+        // Weak scaling: 'p' times the tracks on 'p' threads
+        if (args.weak)
+        {
+            stage_times w1;
+            for (auto p : args.threads)
+            {
+                if (args.verbose)
+                    clog << "Weak scaling on " << p << " threads" << endl;
+
+                vector<size_t> workload;
+                for (size_t i = 0; i < p; ++i)
+                    workload.insert (workload.end (), all.begin (), all.end ());
+
+                const auto tp = (p == 1 && !t1.empty ()) ? t1 : run_tracks (tracks, workload, p, args.repeats);
+                if (p == 1)
+                    w1 = tp;
+
+                // The scaled speedup
+                for (const auto &i : tp)
+                    print ("weak", 1, p, i.first, i.second, p * photons,
+                        p * scaling::speedup (w1[i.first], i.second), p);
+            }
+        }
+
+        // Splits: all of the cores, divided between classify processes
+        // and threads
+        if (args.splits)
+        {
+            auto filenames = args.filenames;
+            filenames.insert (filenames.end (), synthetic_files.filenames.begin (), synthetic_files.filenames.end ());
+
+            // Speedups are relative to one process with one thread
+            if (args.verbose)
+                clog << "1 process with 1 thread, using " << args.classify << endl;
+            const double s1 = run_split (args.classify, filenames, 1, 1, args.repeats);
+
+            for (auto processes : scaling::get_splits (args.cores))
+            {
+                const size_t threads = args.cores / processes;
+
+                if (args.verbose)
+                    clog << processes << " processes with " << threads << " threads each" << endl;
+
+                const double tp = (processes * threads == 1) ? s1
+                    : run_split (args.classify, filenames, processes, threads, args.repeats);
+                print ("split", processes, threads, "total", tp, photons,
+                    scaling::speedup (s1, tp), args.cores);
+            }
+        }
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
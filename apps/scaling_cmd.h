@@ -0,0 +1,142 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cmd_utils.h"
+
+namespace oopp
+{
+
+namespace cmd
+{
+
+struct args
+{
+    bool help = false;
+    bool verbose = false;
+    std::vector<size_t> threads;
+    size_t cores = omp_get_num_procs ();
+    size_t synthetic = 0;
+    size_t tracks = 0;
+    size_t repeats = 3;
+    bool strong = true;
+    bool weak = true;
+    bool splits = true;
+    std::string classify;
+    std::vector<std::string> filenames;
+};
+
+std::ostream &operator<< (std::ostream &os, const args &args)
+{
+    os << std::boolalpha;
+    os << "help: " << args.help << std::endl;
+    os << "verbose: " << args.verbose << std::endl;
+    os << "threads:";
+    for (auto i : args.threads)
+        os << " " << i;
+    os << std::endl;
+    os << "cores: " << args.cores << std::endl;
+    os << "synthetic: " << args.synthetic << std::endl;
+    os << "tracks: " << args.tracks << std::endl;
+    os << "repeats: " << args.repeats << std::endl;
+    os << "strong: " << args.strong << std::endl;
+    os << "weak: " << args.weak << std::endl;
+    os << "splits: " << args.splits << std::endl;
+    os << "classify: '" << args.classify << "'" << std::endl;
+    os << "filenames: " << args.filenames.size () << " total" << std::endl;
+    return os;
+}
+
+const int NO_STRONG_ID = 2001;
+const int NO_WEAK_ID = 2002;
+const int NO_SPLITS_ID = 2003;
+const int CLASSIFY_ID = 2004;
+
+args get_args (int argc, char **argv, const std::string &usage)
+{
+    args args;
+    while (1)
+    {
+        int option_index = 0;
+        static struct option long_options[] = {
+            {"help", no_argument, 0,  'h'},
+            {"verbose", no_argument, 0,  'v'},
+            {"threads", required_argument, 0,  't'},
+            {"cores", required_argument, 0,  'c'},
+            {"synthetic", required_argument, 0,  's'},
+            {"tracks", required_argument, 0,  'n'},
+            {"repeats", required_argument, 0,  'r'},
+            {"no-strong", no_argument, 0,  NO_STRONG_ID},
+            {"no-weak", no_argument, 0,  NO_WEAK_ID},
+            {"no-splits", no_argument, 0,  NO_SPLITS_ID},
+            {"classify", required_argument, 0,  CLASSIFY_ID},
+            {0,      0,           0,  0 }
+        };
+
+        int c = getopt_long(argc, argv, "hvt:c:s:n:r:", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            default:
+            case 0:
+            case 'h':
+            {
+                const size_t noptions = sizeof (long_options) / sizeof (struct option);
+                cmd::print_help (std::clog, usage, noptions, long_options);
+                if (c != 'h')
+                    throw std::runtime_error ("Invalid option");
+                args.help = true;
+                return args;
+            }
+            case 'v': args.verbose = true; break;
+            case 't':
+            {
+                args.threads.clear ();
+                for (auto x : parse_list (optarg))
+                    args.threads.push_back (x);
+                break;
+            }
+            case 'c': args.cores = atol(optarg); break;
+            case 's': args.synthetic = atol(optarg); break;
+            case 'n': args.tracks = atol(optarg); break;
+            case 'r': args.repeats = atol(optarg); break;
+            case NO_STRONG_ID: args.strong = false; break;
+            case NO_WEAK_ID: args.weak = false; break;
+            case NO_SPLITS_ID: args.splits = false; break;
+            case CLASSIFY_ID: args.classify = std::string (optarg); break;
+        }
+    }
+
+    // Check command line
+    assert (optind <= argc);
+    while (optind != argc)
+        args.filenames.push_back (argv[optind++]);
+
+    if (args.cores == 0)
+        throw std::runtime_error ("The number of cores must be positive");
+
+    if (args.repeats == 0)
+        throw std::runtime_error ("The number of repeats must be positive");
+
+    for (auto i : args.threads)
+        if (i == 0)
+            throw std::runtime_error ("Thread counts must be positive");
+
+    // Use the classify app that was built with this one
+    if (args.classify.empty ())
+        args.classify = (std::filesystem::read_symlink ("/proc/self/exe").parent_path () / "classify").string ();
+
+    // Use synthetic tracks when there are no files
+    if (args.filenames.empty () && args.synthetic == 0)
+        args.synthetic = 1'000'000;
+
+    // Give every process of every split at least one track
+    if (args.synthetic != 0 && args.tracks == 0)
+        args.tracks = args.cores;
+
+    return args;
+}
+
+} // namespace cmd
+
+} // namespace oopp
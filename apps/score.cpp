@@ -1,99 +1,34 @@
 #include "oopp/precompiled.h"
+#include "oopp/bootstrap.h"
 #include "oopp/confusion.h"
 #include "oopp/dataframe.h"
+#include "oopp/residuals.h"
+#include "oopp/scoring.h"
+#include "oopp/timer.h"
 #include "score_cmd.h"
 #include "oopp.h"
 
 using namespace std;
 using namespace oopp;
+using namespace oopp::scoring;
 
 const string usage {"score < filename.csv"};
 
-string get_confusion_matrix_header ()
-{
-    stringstream ss;
-    ss << "cls"
-        << "\t" << "acc"
-        << "\t" << "F1"
-        << "\t" << "bal_acc"
-        << "\t" << "cal_F1"
-        << "\t" << "MCC"
-        << "\t" << "Avg"
-        << "\t" << "tp"
-        << "\t" << "tn"
-        << "\t" << "fp"
-        << "\t" << "fn"
-        << "\t" << "support"
-        << "\t" << "total";
-    return ss.str ();
-}
-
-string print (const long cls, const confusion_matrix &cm)
-{
-    stringstream ss;
-    ss << setprecision(3) << fixed;
-    ss << cls
-        << "\t" << cm.accuracy ()
-        << "\t" << cm.F1 ()
-        << "\t" << cm.balanced_accuracy ()
-        << "\t" << cm.calibrated_F_beta ()
-        << "\t" << cm.MCC ()
-        << "\t" << (cm.F1 ()
-                    + cm.balanced_accuracy ()
-                    + cm.calibrated_F_beta ()
-                    + cm.MCC ()) / 4.0
-        << "\t" << cm.true_positives ()
-        << "\t" << cm.true_negatives ()
-        << "\t" << cm.false_positives ()
-        << "\t" << cm.false_negatives ()
-        << "\t" << cm.support ()
-        << "\t" << cm.total ();
-
-    return ss.str ();
-}
-
-unordered_map<long,confusion_matrix> get_confusion_matrix_map (
+multiclass_confusion_matrix get_confusion_matrix (
     const bool verbose,
     istream &is,
     const string &prediction_label,
     const long cls,
-    const long ignore_cls)
+    const long ignore_cls,
+    const size_t block_size,
+    vector<multiclass_confusion_matrix> &blocks,
+    const string &reference_label,
+    residuals::stats &surface,
+    residuals::stats &bathy,
+    size_t &total,
+    const function<void ()> &before_chunk = [] { })
 {
-    // Read the points
-    const auto df = dataframe::read_buffered (is);
-
-    if (verbose)
-        clog << "Converting dataframe" << endl;
-
-    // Convert it to the correct format
-    bool has_manual_label = false;
-    bool has_predictions = false;
-    const auto p = convert_dataframe (df, has_manual_label, has_predictions, prediction_label);
-
-    if (verbose)
-    {
-        clog << p.size () << " points read" << endl;
-        if (has_manual_label)
-            clog << "Dataframe contains manual labels" << endl;
-        else
-            clog << "Dataframe does NOT contain manual labels" << endl;
-        if (has_predictions)
-            clog << "Dataframe contains predictions" << endl;
-        else
-            clog << "Dataframe does NOT contain predictions" << endl;
-        clog << "Sorting points" << endl;
-    }
-
-    set<unsigned> classes;
-
-    if (cls != -1)
-        classes.insert (cls);
-    else
-    {
-        classes.insert (0);
-        classes.insert (40);
-        classes.insert (41);
-    }
+    const auto classes = get_classes (cls);
 
     if (verbose)
     {
@@ -104,68 +39,106 @@ unordered_map<long,confusion_matrix> get_confusion_matrix_map (
         clog << endl;
     }
 
-    // Keep track of performance
-    unordered_map<long,confusion_matrix> cm;
-
-    // Allocate cms
-    for (auto i : classes)
-        cm[i] = confusion_matrix ();
+    // Only the labels and predictions are read, and the elevations if
+    // they are being evaluated
+    vector<string> names {
+        dataframe::LABEL_NAME,
+        prediction_label.empty () ? dataframe::PREDICTION_NAME : prediction_label };
+    const bool elevations = !reference_label.empty ();
+    if (elevations)
+    {
+        names.push_back (reference_label);
+        names.push_back (dataframe::SEA_SURFACE_NAME);
+        names.push_back (dataframe::BATHY_NAME);
+    }
 
+    auto m = get_multiclass_confusion_matrix (classes);
     size_t ignored = 0;
+    total = 0;
 
-    // For each classification
-    for (auto c : classes)
+    // Score each chunk as it is read
+    const auto found = dataframe::read_columns (is, names, [&](const auto &columns)
     {
-        // Allocate cm
-        cm[c] = confusion_matrix ();
-
-        // For each point
-        for (size_t i = 0; i < p.size (); ++i)
+        OOPP_TRACE_SPAN ("chunk");
+
+        before_chunk ();
+
+        const auto &actual = columns[0];
+        const auto &pred = columns[1];
+        size_t n = 0;
+        const auto cm = get_multiclass_confusion_matrix (actual.size (),
+            [&](const size_t i) { return static_cast<long> (actual[i]); },
+            [&](const size_t i) { return static_cast<long> (pred[i]); },
+            classes,
+            ignore_cls,
+            n);
+        m.add (cm);
+        total += actual.size ();
+        ignored += n;
+
+        // Each chunk is a bootstrap block
+        if (block_size != 0)
+            blocks.push_back (cm);
+
+        if (elevations)
         {
-            // Get values
-            long actual = static_cast<long> (p[i].cls);
-            long pred = static_cast<int> (p[i].prediction);
-
-            // Ignore it?
-            if (actual == ignore_cls)
-            {
-                ++ignored;
-                continue;
-            }
-
-            // Map 1 -> 0
-            actual = actual == 1 ? 0 : actual;
-            pred = pred == 1 ? 0 : pred;
-
-            // Update the matrix
-            const bool is_present = (actual == c);
-            const bool is_predicted = (pred == c);
-            cm[c].update (is_present, is_predicted);
+            const auto &reference = columns[2];
+            const auto label = [&](const size_t i) { return static_cast<long> (actual[i]); };
+            const auto ref = [&](const size_t i) { return reference[i]; };
+            surface.add (residuals::get_stats (actual.size (), label,
+                [&](const size_t i) { return columns[3][i]; }, ref, sea_surface_class));
+            bathy.add (residuals::get_stats (actual.size (), label,
+                [&](const size_t i) { return columns[4][i]; }, ref, bathy_class));
         }
-    }
+    }, block_size != 0 ? block_size : 1 << 16);
+
+    if (elevations)
+        for (size_t i = 2; i < names.size (); ++i)
+            if (!found[i])
+                throw runtime_error ("Can't find '" + names[i] + "' in dataframe");
+
+    // Otherwise the whole stream is one block
+    if (block_size == 0)
+        blocks.push_back (m);
 
     if (verbose)
+    {
+        clog << total << " points read" << endl;
+        if (found[0])
+            clog << "Dataframe contains manual labels" << endl;
+        else
+            clog << "Dataframe does NOT contain manual labels" << endl;
+        if (found[1])
+            clog << "Dataframe contains predictions" << endl;
+        else
+            clog << "Dataframe does NOT contain predictions" << endl;
         clog << "Ignored " << ignored << " points" << endl;
+    }
 
-    return cm;
+    return m;
 }
 
-unordered_map<long,confusion_matrix> get_confusion_matrix_map (
+multiclass_confusion_matrix get_confusion_matrix (
     const bool verbose,
     const vector<string> &filenames,
     const string &prediction_label,
     const string &csv_filename,
     const long cls,
-    const long ignore_cls)
+    const long ignore_cls,
+    const size_t block_size,
+    vector<multiclass_confusion_matrix> &blocks,
+    const string &reference_label,
+    residuals::stats &surface,
+    residuals::stats &bathy)
 {
     if (filenames.empty ())
     {
         clog << "No filenames specified. Reading dataframe from stdin..." << endl;
-        return get_confusion_matrix_map (verbose, cin, prediction_label, cls, ignore_cls);
+        size_t total;
+        return get_confusion_matrix (verbose, cin, prediction_label, cls, ignore_cls,
+            block_size, blocks, reference_label, surface, bathy, total);
     }
 
-    vector<unordered_map<long,confusion_matrix>> maps (filenames.size ());
-
     ofstream ofs;
     if (!csv_filename.empty ())
     {
@@ -177,53 +150,91 @@ unordered_map<long,confusion_matrix> get_confusion_matrix_map (
         if (!ofs)
             throw runtime_error ("Could not open file for writing");
 
-        ofs << get_confusion_matrix_header ()
-            << "\tmodel"
-            << "\tfilename"
-            << endl;
+        ofs << get_file_header () << endl;
     }
 
-#pragma omp parallel for
-    for (size_t i = 0; i < filenames.size (); ++i)
+    // Each file gets its own slot, so the loop needs no synchronization
+    vector<string> rows (filenames.size ());
+    vector<string> errors (filenames.size ());
+    vector<vector<multiclass_confusion_matrix>> file_blocks (filenames.size ());
+
+    // The files' matrices are merged by the reduction
+    auto m = get_multiclass_confusion_matrix (get_classes (cls));
+
+    // Start the largest files first, and hand them out one at a time
+    const auto order = cmd::get_largest_first (filenames);
+
+    // Once fewer files are left than threads, the idle threads help
+    // parse the files that are still being read. Each file's share of
+    // the threads is updated before every chunk.
+    const int threads = omp_get_max_threads ();
+    atomic<int> in_progress = 0;
+    const auto set_threads = [&]
+    {
+        omp_set_num_threads (max (1, threads / max (1, in_progress.load ())));
+    };
+    const int levels = omp_get_max_active_levels ();
+    omp_set_max_active_levels (max (levels, 2));
+
+#pragma omp parallel for schedule(dynamic) reduction(+:m,surface,bathy)
+    for (size_t k = 0; k < order.size (); ++k)
     {
+        const size_t i = order[k];
+        ++in_progress;
+        set_threads ();
+
         if (verbose)
         {
 #pragma omp critical
             clog << "Reading " << filenames[i] << endl;
         }
 
-        ifstream ifs (filenames[i]);
+        // Exceptions can't leave the parallel region
+        try
+        {
+            OOPP_TRACE_SPAN ("file");
 
-        if (!ifs)
-            throw runtime_error ("Could not open file for reading");
+            timer::timer t;
 
-        maps[i] = get_confusion_matrix_map (verbose, ifs, prediction_label, cls, ignore_cls);
+            ifstream ifs (filenames[i]);
 
-        if (ofs)
-        {
-            // Copy to map so that it's ordered
-            map<long,confusion_matrix> tmp (maps[i].begin (), maps[i].end ());
-            for (auto j : tmp)
-                ofs << print (j.first, j.second)
-                    << "\t" << (prediction_label.empty () ? "oopp" : prediction_label)
-                    << "\t" << filenames[i]
-                    << endl;
-        }
-    }
+            if (!ifs)
+                throw runtime_error ("Could not open file for reading: " + filenames[i]);
 
-    // Combine them all into one
-    unordered_map<long,confusion_matrix> m;
+            size_t total = 0;
+            const auto cm = get_confusion_matrix (verbose, ifs, prediction_label, cls, ignore_cls, block_size, file_blocks[i], reference_label, surface, bathy, total, set_threads);
+            m.add (cm);
 
-    for (auto i : maps)
-    {
-        for (auto j : i)
+            t.stop ();
+
+            if (!csv_filename.empty ())
+                rows[i] = print_file (get_confusion_matrices (cm),
+                    prediction_label.empty () ? "oopp" : prediction_label,
+                    filenames[i],
+                    total,
+                    t.elapsed_ns () / 1'000'000'000);
+        }
+        catch (const exception &e)
         {
-            const auto key = j.first;
-            const auto cm = j.second;
-            m[key].add (cm);
+            errors[i] = e.what ();
         }
+
+        --in_progress;
     }
 
+    omp_set_max_active_levels (levels);
+
+    for (const auto &e : errors)
+        if (!e.empty ())
+            throw runtime_error (e);
+
+    // Write the per-file results in input order
+    for (const auto &r : rows)
+        ofs << r;
+
+    for (const auto &b : file_blocks)
+        blocks.insert (blocks.end (), b.begin (), b.end ());
+
     return m;
 }
 
@@ -245,55 +256,62 @@ int main (int argc, char **argv)
             clog << args;
         }
 
-        const auto tmp = get_confusion_matrix_map (
+        vector<multiclass_confusion_matrix> blocks;
+        residuals::stats surface;
+        residuals::stats bathy;
+        const auto m = get_confusion_matrix (
             args.verbose,
             args.filenames,
             args.prediction_label,
             args.csv_filename,
             args.cls,
-            args.ignore_cls);
-
-        // Copy map so that it's ordered
-        map<long,confusion_matrix> cmm (tmp.begin (), tmp.end ());
-
-        // Compile results
+            args.ignore_cls,
+            args.block_size,
+            blocks,
+            args.elevations ? args.reference_label : string (),
+            surface,
+            bathy);
+
+        // Compile results, and if you're doing a multi-class score,
+        // computed weighted scores too
         stringstream ss;
-        ss << get_confusion_matrix_header () << endl;
+        ss << print_results (get_confusion_matrices (m), args.cls == -1);
 
-        for (auto i : cmm)
+        // Surface and bathy elevation residuals, in meters
+        if (args.elevations)
         {
-            const auto key = i.first;
-            const auto cm = i.second;
-            ss << print (key, cm) << endl;
+            ss << residuals::get_header () << endl;
+            ss << residuals::print ("surface", surface) << endl;
+            ss << residuals::print ("bathy", bathy) << endl;
+        }
+
+        if (!args.trace.empty ())
+        {
+            if (args.verbose)
+                clog << "Writing trace to " << args.trace << endl;
+
+            trace::write_chrome_trace (args.trace);
         }
 
-        // If you're doing a multi-class score, computed weighted scores too
-        if (args.cls == -1)
+        // Get confidence intervals by resampling files or blocks
+        if (args.bootstrap != 0)
         {
-            double weighted_f1 = 0.0;
-            double weighted_accuracy = 0.0;
-            double weighted_bal_acc = 0.0;
-            double weighted_cal_f1 = 0.0;
-            double weighted_MCC = 0.0;
-            for (auto i : cmm)
-            {
-                const auto cm = i.second;
-                if (!isnan (cm.F1 ()))
-                    weighted_f1 += cm.F1 () * cm.support () / cm.total ();
-                if (!isnan (cm.accuracy ()))
-                    weighted_accuracy += cm.accuracy () * cm.support () / cm.total ();
-                if (!isnan (cm.balanced_accuracy ()))
-                    weighted_bal_acc += cm.balanced_accuracy () * cm.support () / cm.total ();
-                if (!isnan (cm.calibrated_F_beta ()))
-                    weighted_cal_f1 += cm.calibrated_F_beta () * cm.support () / cm.total ();
-                if (!isnan (cm.MCC ()))
-                    weighted_MCC += cm.MCC () * cm.support () / cm.total ();
-            }
-            ss << "weighted_accuracy = " << weighted_accuracy << endl;
-            ss << "weighted_F1 = " << weighted_f1 << endl;
-            ss << "weighted_bal_acc = " << weighted_bal_acc << endl;
-            ss << "weighted_cal_F1 = " << weighted_cal_f1 << endl;
-            ss << "weighted_MCC = " << weighted_MCC << endl;
+            if (blocks.size () < 2)
+                throw runtime_error ("--bootstrap needs at least two blocks, "
+                    "set --block-size or score several files");
+
+            if (args.verbose)
+                clog << "Resampling " << blocks.size () << " blocks "
+                    << args.bootstrap << " times" << endl;
+
+            const auto intervals = bootstrap::get_intervals (blocks,
+                args.bootstrap,
+                args.confidence,
+                args.seed,
+                args.cls == -1);
+
+            ss << bootstrap::get_header () << endl;
+            ss << bootstrap::print (intervals);
         }
 
         // Show results
@@ -2,6 +2,7 @@
 
 #include "oopp/precompiled.h"
 #include "oopp/cmd_utils.h"
+#include "oopp/trace.h"
 
 namespace oopp
 {
@@ -17,6 +18,13 @@ struct args
     std::string prediction_label;
     std::string csv_filename;
     int ignore_cls = -1;
+    size_t bootstrap = 0;
+    size_t block_size = 0;
+    double confidence = 0.95;
+    uint64_t seed = 0;
+    bool elevations = false;
+    std::string reference_label = "geoid_corr_h";
+    std::string trace;
     std::vector<std::string> filenames;
 };
 
@@ -29,10 +37,25 @@ std::ostream &operator<< (std::ostream &os, const args &args)
     os << "prediction-label: '" << args.prediction_label << "'" << std::endl;
     os << "csv-filename: '" << args.csv_filename << "'" << std::endl;
     os << "ignore-class: " << args.ignore_cls << std::endl;
+    os << "bootstrap: " << args.bootstrap << std::endl;
+    os << "block-size: " << args.block_size << std::endl;
+    os << "confidence: " << args.confidence << std::endl;
+    os << "seed: " << args.seed << std::endl;
+    os << "elevations: " << args.elevations << std::endl;
+    os << "reference-label: '" << args.reference_label << "'" << std::endl;
+    os << "trace: '" << args.trace << "'" << std::endl;
     os << "filenames: " << args.filenames.size () << " total" << std::endl;
     return os;
 }
 
+const int BOOTSTRAP_ID = 2001;
+const int BLOCK_SIZE_ID = 2002;
+const int CONFIDENCE_ID = 2003;
+const int SEED_ID = 2004;
+const int ELEVATIONS_ID = 2005;
+const int REFERENCE_LABEL_ID = 2006;
+const int TRACE_ID = 2007;
+
 args get_args (int argc, char **argv, const std::string &usage)
 {
     args args;
@@ -46,6 +69,13 @@ args get_args (int argc, char **argv, const std::string &usage)
             {"prediction-label", required_argument, 0,  'l' },
             {"csv-filename", required_argument, 0,  's' },
             {"ignore-class", required_argument, 0,  'i' },
+            {"bootstrap", required_argument, 0, BOOTSTRAP_ID },
+            {"block-size", required_argument, 0, BLOCK_SIZE_ID },
+            {"confidence", required_argument, 0, CONFIDENCE_ID },
+            {"seed", required_argument, 0, SEED_ID },
+            {"elevations", no_argument, 0, ELEVATIONS_ID },
+            {"reference-label", required_argument, 0, REFERENCE_LABEL_ID },
+            {"trace", required_argument, 0, TRACE_ID },
             {0,      0,           0,  0 }
         };
 
@@ -70,6 +100,13 @@ args get_args (int argc, char **argv, const std::string &usage)
             case 'l': args.prediction_label = std::string(optarg); break;
             case 's': args.csv_filename = std::string(optarg); break;
             case 'i': args.ignore_cls = atol(optarg); break;
+            case BOOTSTRAP_ID: args.bootstrap = atol(optarg); break;
+            case BLOCK_SIZE_ID: args.block_size = atol(optarg); break;
+            case CONFIDENCE_ID: args.confidence = atof(optarg); break;
+            case SEED_ID: args.seed = atol(optarg); break;
+            case ELEVATIONS_ID: args.elevations = true; break;
+            case REFERENCE_LABEL_ID: args.reference_label = std::string(optarg); break;
+            case TRACE_ID: args.trace = std::string(optarg); break;
         }
     }
 
@@ -78,6 +115,14 @@ args get_args (int argc, char **argv, const std::string &usage)
     while (optind != argc)
         args.filenames.push_back (argv[optind++]);
 
+    // Otherwise there is a single block to resample
+    if (args.bootstrap != 0 && args.block_size == 0 && args.filenames.size () < 2)
+        throw std::runtime_error ("--bootstrap needs at least two blocks, "
+            "set --block-size or score several files");
+
+    if (!args.trace.empty () && !trace::enabled ())
+        throw std::runtime_error ("This build does not record traces, configure it with -DOOPP_TRACE=ON");
+
     return args;
 }
 
@@ -0,0 +1,242 @@
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/search.h"
+#include "oopp/sweep.h"
+#include "oopp/timer.h"
+#include "search_cmd.h"
+#include "oopp.h"
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"search [options] filename1.csv [filename2.csv ...] | search [options] --batch=filenames.txt"};
+
+// Read labeled tracks, largest first, in parallel
+vector<vector<photon>> read_tracks (const vector<string> &filenames)
+{
+    // Exceptions can't leave a parallel region, so save them here
+    vector<string> errors (filenames.size ());
+
+    vector<vector<photon>> tracks (filenames.size ());
+    const auto order = cmd::get_largest_first (filenames);
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < order.size (); ++k)
+    {
+        const size_t i = order[k];
+        try
+        {
+            const auto df = dataframe::read_buffered (filenames[i]);
+
+            bool has_manual_label = false;
+            bool has_predictions = false;
+            tracks[i] = dataframe::convert_dataframe (df, has_manual_label, has_predictions, string ());
+
+            if (!has_manual_label)
+                throw runtime_error ("Dataframe does NOT contain manual labels");
+        }
+        catch (const exception &e)
+        {
+            errors[i] = filenames[i] + ": " + e.what ();
+        }
+    }
+
+    for (const auto &e : errors)
+        if (!e.empty ())
+            throw runtime_error (e);
+
+    return tracks;
+}
+
+/// @brief Score configurations with successive halving
+/// @param tracks Tracks, which are shuffled
+/// @param configs Configurations
+/// @param classes Classes to score
+/// @param files Number of tracks that each configuration was scored on
+/// @param args Command line args
+/// @return Confusion matrices for each configuration, summed over the tracks it was scored on
+///
+/// Every configuration is scored on a few tracks, and the best are
+/// scored on more tracks, until the last few are scored on all of
+/// them. The tracks are shuffled so that each rung adds a random
+/// sample. Matrices add, so each rung only scores the new tracks.
+vector<scoring::confusion_matrices> search_halving (vector<vector<photon>> &tracks,
+    const vector<params> &configs,
+    const set<long> &classes,
+    vector<size_t> &files,
+    const cmd::args &args)
+{
+    mt19937 rng (args.seed);
+    shuffle (tracks.begin (), tracks.end (), rng);
+
+    // photons[i] is the number of photons in the first 'i' tracks
+    vector<size_t> photons (tracks.size () + 1);
+    for (size_t i = 0; i < tracks.size (); ++i)
+        photons[i + 1] = photons[i] + tracks[i].size ();
+
+    vector<scoring::confusion_matrices> cms (configs.size (),
+        scoring::get_confusion_matrices (classes));
+    fill (files.begin (), files.end (), 0);
+
+    // Number of photons classified by all of the configurations
+    size_t cost = 0;
+
+    const auto evaluate = [&](const vector<size_t> &indexes, const size_t first, const size_t last)
+    {
+        if (args.verbose)
+            clog << "Scoring " << indexes.size () << " configurations on "
+                << last << " files" << endl;
+
+        vector<params> p;
+        for (auto i : indexes)
+            p.push_back (configs[i]);
+
+        const auto tmp = sweep::sweep (tracks, first, last, p, classes, args.ignore_cls);
+        for (size_t i = 0; i < indexes.size (); ++i)
+        {
+            scoring::add (cms[indexes[i]], tmp[i]);
+            files[indexes[i]] = last;
+        }
+
+        cost += indexes.size () * (photons[last] - photons[first]);
+    };
+
+    const auto score = [&](const size_t i)
+        { return search::get_score (search::get_scores (cms[i], args.rank_cls), args.metric); };
+
+    const auto rungs = search::get_rungs (configs.size (), tracks.size (), args.min_files, args.eta);
+    search::successive_halving (rungs, evaluate, score);
+
+    if (args.verbose)
+    {
+        const double full = static_cast<double> (configs.size ()) * photons.back ();
+        clog << rungs.size () << " rungs scored "
+            << fixed << setprecision (1) << (full == 0.0 ? 0.0 : 100.0 * cost / full)
+            << "% of the photons of a full search" << endl;
+        clog << defaultfloat;
+    }
+
+    return cms;
+}
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        // Parse the args
+        const auto args = cmd::get_args (argc, argv, usage);
+
+        // If you are getting help, exit without an error
+        if (args.help)
+            return 0;
+
+        if (args.verbose)
+        {
+            // Show the args
+            clog << "cmd_line_parameters:" << endl;
+            clog << args;
+        }
+
+        // Start a timer
+        timer::timer t0;
+
+        // Read each track once
+        if (args.verbose)
+            clog << "Reading " << args.filenames.size () << " files" << endl;
+
+        auto tracks = read_tracks (args.filenames);
+
+        size_t total_photons = 0;
+        for (const auto &p : tracks)
+            total_photons += p.size ();
+
+        // Get the configurations
+        const params base;
+        vector<params> configs;
+        if (args.mode == "grid")
+            configs = search::get_grid (base, args.dims, args.grid_points);
+        else if (args.mode == "random")
+            configs = search::get_random (base, args.dims, args.samples, args.seed);
+        else
+            configs = search::get_latin_hypercube (base, args.dims, args.samples, args.seed);
+
+        if (args.verbose)
+        {
+            clog << total_photons << " photons read" << endl;
+            clog << "Evaluating " << configs.size () << " configurations in "
+                << sweep::group_by_binning (configs).size () << " binning groups" << endl;
+        }
+
+        // Start a timer
+        timer::timer t1;
+
+        // Score each configuration
+        const auto classes = scoring::get_classes (args.cls);
+        vector<scoring::confusion_matrices> cms;
+        vector<size_t> files (configs.size (), tracks.size ());
+
+        if (args.halving)
+            cms = search_halving (tracks, configs, classes, files, args);
+        else
+            cms = sweep::sweep (tracks, configs, classes, args.ignore_cls);
+
+        t1.stop ();
+
+        // Rank them
+        vector<scoring::weighted_scores> scores (cms.size ());
+        vector<double> s (cms.size ());
+        for (size_t i = 0; i < cms.size (); ++i)
+        {
+            scores[i] = search::get_scores (cms[i], args.rank_cls);
+            s[i] = search::get_score (scores[i], args.metric);
+        }
+
+        const auto ranking = search::get_ranking (s, files);
+        const size_t rows = args.top == 0 ? ranking.size () : min (args.top, ranking.size ());
+
+        // Compile results
+        stringstream ss;
+        ss << "rank"
+            << "\t" << "config"
+            << "\t" << "files"
+            << "\t" << args.metric
+            << "\t" << sweep::get_params_header ()
+            << "\t" << search::get_scores_header ()
+            << endl;
+
+        for (size_t i = 0; i < rows; ++i)
+        {
+            const size_t j = ranking[i];
+            ss << i + 1
+                << "\t" << j
+                << "\t" << files[j]
+                << "\t" << fixed << setprecision (3) << s[j]
+                << "\t" << defaultfloat << sweep::print_params (configs[j])
+                << "\t" << search::print (args.rank_cls, scores[j])
+                << endl;
+        }
+
+        // Write results to stdout
+        cout << ss.str ();
+
+        t0.stop ();
+
+        // Write out performance stats
+        if (args.verbose)
+        {
+            const double s0 = t0.elapsed_ns () / 1'000'000'000;
+            const double s1 = t1.elapsed_ns () / 1'000'000'000;
+            clog << fixed;
+            clog << setprecision(3);
+            clog << s0 << "/" << s1 << " total/search seconds" << endl;
+            clog << configs.size () / s1 << " configurations per second" << endl;
+        }
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
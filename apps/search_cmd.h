@@ -0,0 +1,238 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cmd_utils.h"
+#include "oopp/oopp.h"
+#include "oopp/search.h"
+
+namespace oopp
+{
+
+namespace cmd
+{
+
+struct args
+{
+    bool help = false;
+    bool verbose = false;
+    std::string batch;
+    int cls = -1;
+    int ignore_cls = -1;
+    std::string mode = "grid";
+    size_t samples = 100;
+    size_t grid_points = 5;
+    unsigned seed = 0;
+    std::string metric = "F1";
+    int rank_cls = oopp::bathy_class;
+    size_t top = 0;
+    bool halving = false;
+    double eta = 3.0;
+    size_t min_files = 4;
+    std::vector<search::dimension> dims;
+    std::vector<std::string> filenames;
+};
+
+std::ostream &operator<< (std::ostream &os, const args &args)
+{
+    os << std::boolalpha;
+    os << "help: " << args.help << std::endl;
+    os << "verbose: " << args.verbose << std::endl;
+    os << "batch: '" << args.batch << "'" << std::endl;
+    os << "class: " << args.cls << std::endl;
+    os << "ignore-class: " << args.ignore_cls << std::endl;
+    os << "mode: " << args.mode << std::endl;
+    os << "samples: " << args.samples << std::endl;
+    os << "grid-points: " << args.grid_points << std::endl;
+    os << "seed: " << args.seed << std::endl;
+    os << "metric: " << args.metric << std::endl;
+    os << "rank-class: " << args.rank_cls << std::endl;
+    os << "top: " << args.top << std::endl;
+    os << "halving: " << args.halving << std::endl;
+    os << "eta: " << args.eta << std::endl;
+    os << "min-files: " << args.min_files << std::endl;
+    for (const auto &d : args.dims)
+    {
+        os << d.name << ":";
+        if (d.values.empty ())
+            os << " " << d.min << " to " << d.max;
+        for (auto x : d.values)
+            os << " " << x;
+        os << std::endl;
+    }
+    os << "filenames: " << args.filenames.size () << " total" << std::endl;
+    return os;
+}
+
+const int OO_X_RESOLUTION_ID = 1001;
+const int OO_Z_RESOLUTION_ID = 1002;
+const int OO_Z_MIN_ID = 1003;
+const int OO_Z_MAX_ID = 1004;
+const int OO_SURFACE_Z_MIN_ID = 1005;
+const int OO_SURFACE_Z_MAX_ID = 1006;
+const int OO_BATHY_MIN_DEPTH_ID = 1007;
+const int OO_VERTICAL_SMOOTHING_SIGMA_ID = 1008;
+const int OO_SURFACE_SMOOTHING_SIGMA_ID = 1009;
+const int OO_BATHY_SMOOTHING_SIGMA_ID = 1010;
+const int OO_MIN_PEAK_PROMINENCE_ID = 1011;
+const int OO_MIN_PEAK_DISTANCE_ID = 1012;
+const int OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID = 1013;
+const int OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID = 1014;
+const int OO_SURFACE_N_STDDEV = 1015;
+const int OO_BATHY_N_STDDEV = 1016;
+const int BATCH_ID = 2001;
+const int MODE_ID = 2002;
+const int GRID_POINTS_ID = 2003;
+const int METRIC_ID = 2004;
+const int RANK_CLASS_ID = 2005;
+const int HALVING_ID = 2006;
+const int ETA_ID = 2007;
+const int MIN_FILES_ID = 2008;
+
+/// @brief Add a dimension, replacing any earlier one for the same parameter
+/// @param dims Dimensions
+/// @param name Parameter name
+/// @param spec List or range of values
+/// @param f Function that assigns a value to a parameter set
+/// @param integer True if the parameter only takes integer values
+template<typename F>
+void add (std::vector<search::dimension> &dims, const std::string &name, const std::string &spec, F f, const bool integer = false)
+{
+    std::erase_if (dims, [&](const auto &d) { return d.name == name; });
+    dims.push_back (search::get_dimension (name, spec, f, integer));
+}
+
+args get_args (int argc, char **argv, const std::string &usage)
+{
+    args args;
+    auto &d = args.dims;
+    while (1)
+    {
+        int option_index = 0;
+        static struct option long_options[] = {
+            {"help", no_argument, 0,  'h'},
+            {"verbose", no_argument, 0,  'v'},
+            {"batch", required_argument, 0, BATCH_ID},
+            {"class", required_argument, 0,  'c' },
+            {"ignore-class", required_argument, 0,  'i' },
+            {"mode", required_argument, 0, MODE_ID},
+            {"samples", required_argument, 0,  'n' },
+            {"grid-points", required_argument, 0, GRID_POINTS_ID},
+            {"seed", required_argument, 0,  's' },
+            {"metric", required_argument, 0, METRIC_ID},
+            {"rank-class", required_argument, 0, RANK_CLASS_ID},
+            {"top", required_argument, 0,  't' },
+            {"halving", no_argument, 0, HALVING_ID},
+            {"eta", required_argument, 0, ETA_ID},
+            {"min-files", required_argument, 0, MIN_FILES_ID},
+            {"oo-x-resolution", required_argument, 0, OO_X_RESOLUTION_ID},
+            {"oo-z-resolution", required_argument, 0, OO_Z_RESOLUTION_ID},
+            {"oo-z-min", required_argument, 0, OO_Z_MIN_ID},
+            {"oo-z-max", required_argument, 0, OO_Z_MAX_ID},
+            {"oo-surface-z-min-id", required_argument, 0, OO_SURFACE_Z_MIN_ID},
+            {"oo-surface-z-max-id", required_argument, 0, OO_SURFACE_Z_MAX_ID},
+            {"oo-bathy-min-depth-id", required_argument, 0, OO_BATHY_MIN_DEPTH_ID},
+            {"oo-vertical-smoothing-sigma-id", required_argument, 0, OO_VERTICAL_SMOOTHING_SIGMA_ID},
+            {"oo-surface-smoothing-sigma-id", required_argument, 0, OO_SURFACE_SMOOTHING_SIGMA_ID},
+            {"oo-bathy-smoothing-sigma-id", required_argument, 0, OO_BATHY_SMOOTHING_SIGMA_ID},
+            {"oo-min-peak-prominence-id", required_argument, 0, OO_MIN_PEAK_PROMINENCE_ID},
+            {"oo-min-peak-distance-id", required_argument, 0, OO_MIN_PEAK_DISTANCE_ID},
+            {"oo-min-surface-photons-per-window-id", required_argument, 0, OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID},
+            {"oo-min-bathy-photons-per-window-id", required_argument, 0, OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID},
+            {"oo-surface-n-stddev", required_argument, 0, OO_SURFACE_N_STDDEV},
+            {"oo-bathy-n-stddev", required_argument, 0, OO_BATHY_N_STDDEV},
+            {0,      0,           0,  0 }
+        };
+
+        int c = getopt_long(argc, argv, "hvc:i:n:s:t:", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        // Dimensions are named after their option
+        const std::string name = long_options[option_index].name;
+
+        switch (c) {
+            default:
+            case 0:
+            case 'h':
+            {
+                const size_t noptions = sizeof (long_options) / sizeof (struct option);
+                cmd::print_help (std::clog, usage, noptions, long_options);
+                if (c != 'h')
+                    throw std::runtime_error ("Invalid option");
+                args.help = true;
+                return args;
+            }
+            case 'v': args.verbose = true; break;
+            case BATCH_ID: args.batch = std::string (optarg); break;
+            case 'c': args.cls = atol(optarg); break;
+            case 'i': args.ignore_cls = atol(optarg); break;
+            case MODE_ID: args.mode = std::string (optarg); break;
+            case 'n': args.samples = atol(optarg); break;
+            case GRID_POINTS_ID: args.grid_points = atol(optarg); break;
+            case 's': args.seed = atol(optarg); break;
+            case METRIC_ID: args.metric = std::string (optarg); break;
+            case RANK_CLASS_ID: args.rank_cls = atol(optarg); break;
+            case 't': args.top = atol(optarg); break;
+            case HALVING_ID: args.halving = true; break;
+            case ETA_ID: args.eta = atof(optarg); break;
+            case MIN_FILES_ID: args.min_files = atol(optarg); break;
+            case OO_X_RESOLUTION_ID: add (d, name, optarg, [](auto &a, double x) { a.x_resolution = x; }); break;
+            case OO_Z_RESOLUTION_ID: add (d, name, optarg, [](auto &a, double x) { a.z_resolution = x; }); break;
+            case OO_Z_MIN_ID: add (d, name, optarg, [](auto &a, double x) { a.z_min = x; }); break;
+            case OO_Z_MAX_ID: add (d, name, optarg, [](auto &a, double x) { a.z_max = x; }); break;
+            case OO_SURFACE_Z_MIN_ID: add (d, name, optarg, [](auto &a, double x) { a.surface_z_min = x; }); break;
+            case OO_SURFACE_Z_MAX_ID: add (d, name, optarg, [](auto &a, double x) { a.surface_z_max = x; }); break;
+            case OO_BATHY_MIN_DEPTH_ID: add (d, name, optarg, [](auto &a, double x) { a.bathy_min_depth = x; }); break;
+            case OO_VERTICAL_SMOOTHING_SIGMA_ID: add (d, name, optarg, [](auto &a, double x) { a.vertical_smoothing_sigma = x; }); break;
+            case OO_SURFACE_SMOOTHING_SIGMA_ID: add (d, name, optarg, [](auto &a, double x) { a.surface_smoothing_sigma = x; }); break;
+            case OO_BATHY_SMOOTHING_SIGMA_ID: add (d, name, optarg, [](auto &a, double x) { a.bathy_smoothing_sigma = x; }); break;
+            case OO_MIN_PEAK_PROMINENCE_ID: add (d, name, optarg, [](auto &a, double x) { a.min_peak_prominence = x; }); break;
+            case OO_MIN_PEAK_DISTANCE_ID: add (d, name, optarg, [](auto &a, double x) { a.min_peak_distance = x; }, true); break;
+            case OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID: add (d, name, optarg, [](auto &a, double x) { a.min_surface_photons_per_window = x; }, true); break;
+            case OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID: add (d, name, optarg, [](auto &a, double x) { a.min_bathy_photons_per_window = x; }, true); break;
+            case OO_SURFACE_N_STDDEV: add (d, name, optarg, [](auto &a, double x) { a.surface_n_stddev = x; }); break;
+            case OO_BATHY_N_STDDEV: add (d, name, optarg, [](auto &a, double x) { a.bathy_n_stddev = x; }); break;
+        }
+    }
+
+    // Check command line
+    assert (optind <= argc);
+    while (optind != argc)
+        args.filenames.push_back (argv[optind++]);
+
+    if (!args.batch.empty ())
+    {
+        const auto filenames = read_filenames (args.batch);
+        args.filenames.insert (args.filenames.end (), filenames.begin (), filenames.end ());
+    }
+
+    if (args.filenames.empty ())
+        throw std::runtime_error ("No filenames were specified");
+
+    if (args.mode != "grid" && args.mode != "random" && args.mode != "lhs")
+        throw std::runtime_error ("The mode must be 'grid', 'random', or 'lhs'");
+
+    if (args.samples == 0)
+        throw std::runtime_error ("The number of samples must be positive");
+
+    if (args.grid_points == 0)
+        throw std::runtime_error ("The number of grid points must be positive");
+
+    if (!(args.eta > 1.0))
+        throw std::runtime_error ("The halving factor must be greater than 1");
+
+    if (args.min_files == 0)
+        throw std::runtime_error ("The number of files in the first rung must be positive");
+
+    if (std::find (search::metrics.begin (), search::metrics.end (), args.metric) == search::metrics.end ())
+        throw std::runtime_error ("Unknown metric: '" + args.metric + "'");
+
+    if (args.rank_cls != -1 && !scoring::get_classes (args.cls).contains (args.rank_cls))
+        throw std::runtime_error ("The rank class must be one of the scored classes");
+
+    return args;
+}
+
+} // namespace cmd
+
+} // namespace oopp
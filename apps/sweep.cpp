@@ -0,0 +1,107 @@
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/sweep.h"
+#include "oopp/timer.h"
+#include "sweep_cmd.h"
+#include "oopp.h"
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"sweep [options] filename1.csv [filename2.csv ...]"};
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        // Parse the args
+        const auto args = cmd::get_args (argc, argv, usage);
+
+        // If you are getting help, exit without an error
+        if (args.help)
+            return 0;
+
+        if (args.verbose)
+        {
+            // Show the args
+            clog << "cmd_line_parameters:" << endl;
+            clog << args;
+        }
+
+        // Start a timer
+        timer::timer t0;
+
+        // Read each track once
+        vector<vector<photon>> tracks (args.filenames.size ());
+        size_t total_photons = 0;
+
+        for (size_t i = 0; i < args.filenames.size (); ++i)
+        {
+            if (args.verbose)
+                clog << "Reading " << args.filenames[i] << endl;
+
+            const auto df = dataframe::read_buffered (args.filenames[i]);
+
+            bool has_manual_label = false;
+            bool has_predictions = false;
+            tracks[i] = dataframe::convert_dataframe (df, has_manual_label, has_predictions, string ());
+
+            if (!has_manual_label)
+                throw runtime_error ("Dataframe does NOT contain manual labels: " + args.filenames[i]);
+
+            total_photons += tracks[i].size ();
+        }
+
+        if (args.verbose)
+        {
+            clog << total_photons << " photons read" << endl;
+            clog << "Evaluating " << args.oo_params.size () << " parameter sets in "
+                << sweep::group_by_binning (args.oo_params).size () << " binning groups" << endl;
+        }
+
+        // Start a timer
+        timer::timer t1;
+
+        // Score each parameter set
+        const auto classes = scoring::get_classes (args.cls);
+        const auto cms = sweep::sweep (tracks, args.oo_params, classes, args.ignore_cls);
+
+        t1.stop ();
+
+        // Compile results
+        stringstream ss;
+        ss << "config"
+            << "\t" << sweep::get_params_header ()
+            << "\t" << scoring::get_confusion_matrix_header ()
+            << endl;
+
+        for (size_t i = 0; i < cms.size (); ++i)
+            for (const auto &j : cms[i])
+                ss << i
+                    << "\t" << sweep::print_params (args.oo_params[i])
+                    << "\t" << scoring::print (j.first, j.second)
+                    << endl;
+
+        // Write results to stdout
+        cout << ss.str ();
+
+        t0.stop ();
+
+        // Write out performance stats
+        if (args.verbose)
+        {
+            const double s0 = t0.elapsed_ns () / 1'000'000'000;
+            const double s1 = t1.elapsed_ns () / 1'000'000'000;
+            clog << fixed;
+            clog << setprecision(3);
+            clog << s0 << "/" << s1 << " total/sweep seconds" << endl;
+        }
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
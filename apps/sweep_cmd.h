@@ -0,0 +1,155 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cmd_utils.h"
+#include "oopp/oopp.h"
+
+namespace oopp
+{
+
+namespace cmd
+{
+
+struct args
+{
+    bool help = false;
+    bool verbose = false;
+    int cls = -1;
+    int ignore_cls = -1;
+    std::vector<oopp::params> oo_params { oopp::params () };
+    std::vector<std::string> filenames;
+};
+
+std::ostream &operator<< (std::ostream &os, const args &args)
+{
+    os << std::boolalpha;
+    os << "help: " << args.help << std::endl;
+    os << "verbose: " << args.verbose << std::endl;
+    os << "class: " << args.cls << std::endl;
+    os << "ignore-class: " << args.ignore_cls << std::endl;
+    os << "parameter sets: " << args.oo_params.size () << " total" << std::endl;
+    os << "filenames: " << args.filenames.size () << " total" << std::endl;
+    return os;
+}
+
+const int OO_X_RESOLUTION_ID = 1001;
+const int OO_Z_RESOLUTION_ID = 1002;
+const int OO_Z_MIN_ID = 1003;
+const int OO_Z_MAX_ID = 1004;
+const int OO_SURFACE_Z_MIN_ID = 1005;
+const int OO_SURFACE_Z_MAX_ID = 1006;
+const int OO_BATHY_MIN_DEPTH_ID = 1007;
+const int OO_VERTICAL_SMOOTHING_SIGMA_ID = 1008;
+const int OO_SURFACE_SMOOTHING_SIGMA_ID = 1009;
+const int OO_BATHY_SMOOTHING_SIGMA_ID = 1010;
+const int OO_MIN_PEAK_PROMINENCE_ID = 1011;
+const int OO_MIN_PEAK_DISTANCE_ID = 1012;
+const int OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID = 1013;
+const int OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID = 1014;
+const int OO_SURFACE_N_STDDEV = 1015;
+const int OO_BATHY_N_STDDEV = 1016;
+
+/// @brief Replace each parameter set with one set per value in a list
+/// @param p Parameter sets
+/// @param s Comma separated list of values
+/// @param f Function that assigns a value to a parameter set
+template<typename T,typename F>
+void expand (std::vector<T> &p, const std::string &s, F f)
+{
+    const auto values = parse_list (s);
+    std::vector<T> tmp;
+    tmp.reserve (p.size () * values.size ());
+    for (const auto &i : p)
+    {
+        for (auto x : values)
+        {
+            tmp.push_back (i);
+            f (tmp.back (), x);
+        }
+    }
+    p.swap (tmp);
+}
+
+args get_args (int argc, char **argv, const std::string &usage)
+{
+    args args;
+    auto &p = args.oo_params;
+    while (1)
+    {
+        int option_index = 0;
+        static struct option long_options[] = {
+            {"help", no_argument, 0,  'h'},
+            {"verbose", no_argument, 0,  'v'},
+            {"class", required_argument, 0,  'c' },
+            {"ignore-class", required_argument, 0,  'i' },
+            {"oo-x-resolution", required_argument, 0, OO_X_RESOLUTION_ID},
+            {"oo-z-resolution", required_argument, 0, OO_Z_RESOLUTION_ID},
+            {"oo-z-min", required_argument, 0, OO_Z_MIN_ID},
+            {"oo-z-max", required_argument, 0, OO_Z_MAX_ID},
+            {"oo-surface-z-min-id", required_argument, 0, OO_SURFACE_Z_MIN_ID},
+            {"oo-surface-z-max-id", required_argument, 0, OO_SURFACE_Z_MAX_ID},
+            {"oo-bathy-min-depth-id", required_argument, 0, OO_BATHY_MIN_DEPTH_ID},
+            {"oo-vertical-smoothing-sigma-id", required_argument, 0, OO_VERTICAL_SMOOTHING_SIGMA_ID},
+            {"oo-surface-smoothing-sigma-id", required_argument, 0, OO_SURFACE_SMOOTHING_SIGMA_ID},
+            {"oo-bathy-smoothing-sigma-id", required_argument, 0, OO_BATHY_SMOOTHING_SIGMA_ID},
+            {"oo-min-peak-prominence-id", required_argument, 0, OO_MIN_PEAK_PROMINENCE_ID},
+            {"oo-min-peak-distance-id", required_argument, 0, OO_MIN_PEAK_DISTANCE_ID},
+            {"oo-min-surface-photons-per-window-id", required_argument, 0, OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID},
+            {"oo-min-bathy-photons-per-window-id", required_argument, 0, OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID},
+            {"oo-surface-n-stddev", required_argument, 0, OO_SURFACE_N_STDDEV},
+            {"oo-bathy-n-stddev", required_argument, 0, OO_BATHY_N_STDDEV},
+            {0,      0,           0,  0 }
+        };
+
+        int c = getopt_long(argc, argv, "hvc:i:", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            default:
+            case 0:
+            case 'h':
+            {
+                const size_t noptions = sizeof (long_options) / sizeof (struct option);
+                cmd::print_help (std::clog, usage, noptions, long_options);
+                if (c != 'h')
+                    throw std::runtime_error ("Invalid option");
+                args.help = true;
+                return args;
+            }
+            case 'v': args.verbose = true; break;
+            case 'c': args.cls = atol(optarg); break;
+            case 'i': args.ignore_cls = atol(optarg); break;
+            case OO_X_RESOLUTION_ID: expand (p, optarg, [](auto &a, double x) { a.x_resolution = x; }); break;
+            case OO_Z_RESOLUTION_ID: expand (p, optarg, [](auto &a, double x) { a.z_resolution = x; }); break;
+            case OO_Z_MIN_ID: expand (p, optarg, [](auto &a, double x) { a.z_min = x; }); break;
+            case OO_Z_MAX_ID: expand (p, optarg, [](auto &a, double x) { a.z_max = x; }); break;
+            case OO_SURFACE_Z_MIN_ID: expand (p, optarg, [](auto &a, double x) { a.surface_z_min = x; }); break;
+            case OO_SURFACE_Z_MAX_ID: expand (p, optarg, [](auto &a, double x) { a.surface_z_max = x; }); break;
+            case OO_BATHY_MIN_DEPTH_ID: expand (p, optarg, [](auto &a, double x) { a.bathy_min_depth = x; }); break;
+            case OO_VERTICAL_SMOOTHING_SIGMA_ID: expand (p, optarg, [](auto &a, double x) { a.vertical_smoothing_sigma = x; }); break;
+            case OO_SURFACE_SMOOTHING_SIGMA_ID: expand (p, optarg, [](auto &a, double x) { a.surface_smoothing_sigma = x; }); break;
+            case OO_BATHY_SMOOTHING_SIGMA_ID: expand (p, optarg, [](auto &a, double x) { a.bathy_smoothing_sigma = x; }); break;
+            case OO_MIN_PEAK_PROMINENCE_ID: expand (p, optarg, [](auto &a, double x) { a.min_peak_prominence = x; }); break;
+            case OO_MIN_PEAK_DISTANCE_ID: expand (p, optarg, [](auto &a, double x) { a.min_peak_distance = x; }); break;
+            case OO_MIN_SURFACE_PHOTONS_PER_WINDOW_ID: expand (p, optarg, [](auto &a, double x) { a.min_surface_photons_per_window = x; }); break;
+            case OO_MIN_BATHY_PHOTONS_PER_WINDOW_ID: expand (p, optarg, [](auto &a, double x) { a.min_bathy_photons_per_window = x; }); break;
+            case OO_SURFACE_N_STDDEV: expand (p, optarg, [](auto &a, double x) { a.surface_n_stddev = x; }); break;
+            case OO_BATHY_N_STDDEV: expand (p, optarg, [](auto &a, double x) { a.bathy_n_stddev = x; }); break;
+        }
+    }
+
+    // Check command line
+    assert (optind <= argc);
+    while (optind != argc)
+        args.filenames.push_back (argv[optind++]);
+
+    if (args.filenames.empty ())
+        throw std::runtime_error ("No filenames were specified");
+
+    return args;
+}
+
+} // namespace cmd
+
+} // namespace oopp
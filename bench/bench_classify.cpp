@@ -0,0 +1,209 @@
+// Report the memory use of each stage
+#define OOPP_COUNT_ALLOCATIONS
+
+#include "oopp/precompiled.h"
+#include "oopp/counters.h"
+#include "oopp/dataframe.h"
+#include "oopp/oopp.h"
+#include "oopp/profile.h"
+#include "oopp/synthetic.h"
+#include "oopp/timer.h"
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"bench_classify [photons1 photons2 ...]"};
+
+// Number of times each stage is run. The fastest run is reported.
+const size_t reps = 3;
+
+// Wall time, memory use and hardware counts of one run
+struct measurement
+{
+    profile::stage s;
+    counters::values counts;
+};
+
+// Subtract the time, allocations and counts of a run that is included
+// in another one. Memory peaks are those of the including run.
+measurement operator- (const measurement &a, const measurement &b)
+{
+    measurement m { a.s, {} };
+    m.s.seconds = max (0.0, a.s.seconds - b.s.seconds);
+    m.s.allocations = a.s.allocations - b.s.allocations;
+    m.s.bytes = a.s.bytes - b.s.bytes;
+    for (size_t i = 0; i < counters::event_count; ++i)
+    {
+        const double d = a.counts[i] - b.counts[i];
+        m.counts[i] = isnan (d) ? d : max (0.0, d);
+    }
+    return m;
+}
+
+// Get the fastest of several runs of a function, along with its counts
+template<typename F>
+measurement measure (counters::counter_set &c, F f)
+{
+    measurement best;
+    best.s.seconds = numeric_limits<double>::max ();
+    for (size_t i = 0; i < reps; ++i)
+    {
+        profile::profiler prof;
+        c.start ();
+        prof.run ("", 0, f);
+        const auto counts = c.stop ();
+        const auto &s = prof.get_stages ().back ();
+        if (s.seconds < best.s.seconds)
+            best = measurement { s, counts };
+    }
+    return best;
+}
+
+void print_header ()
+{
+    cout << "photons"
+        << "\t" << "stage"
+        << "\t" << "seconds"
+        << "\t" << "photons_per_second"
+        << "\t" << "cycles"
+        << "\t" << "instructions"
+        << "\t" << "IPC"
+        << "\t" << "L1d_misses_per_photon"
+        << "\t" << "LLC_misses_per_photon"
+        << "\t" << "branch_misses_per_photon"
+        << "\t" << "allocations"
+        << "\t" << "bytes_allocated"
+        << "\t" << "peak_heap_bytes"
+        << "\t" << "peak_rss_bytes"
+        << endl;
+}
+
+// Counts that are not available are printed as 'nan'
+void print (const size_t photons, const string &stage, const measurement &m)
+{
+    using namespace oopp::counters;
+
+    const auto &c = m.counts;
+    const auto &s = m.s;
+    cout << photons
+        << "\t" << stage
+        << "\t" << fixed << setprecision (6) << s.seconds
+        << "\t" << setprecision (0) << (s.seconds == 0.0 ? 0.0 : photons / s.seconds)
+        << "\t" << c[cycles]
+        << "\t" << c[instructions]
+        << "\t" << setprecision (3) << IPC (c)
+        << "\t" << c[L1d_misses] / photons
+        << "\t" << c[LLC_misses] / photons
+        << "\t" << c[branch_misses] / photons
+        << "\t" << s.allocations
+        << "\t" << s.bytes
+        << "\t" << s.peak_heap_bytes
+        << "\t" << s.peak_rss_bytes
+        << endl;
+}
+
+void bench (counters::counter_set &c, const size_t photons)
+{
+    const params params;
+
+    // Generate a track and its CSV
+    synthetic::track_params tp;
+    tp.length = photons / tp.density;
+    const auto track = synthetic::get_track (tp);
+
+    stringstream csv;
+    write_predictions (csv, track);
+    const auto csv_string = csv.str ();
+
+    // Ingest
+    vector<photon> p;
+    print (track.size (), "ingest", measure (c, [&]
+    {
+        istringstream is (csv_string);
+        const auto df = dataframe::read_buffered (is);
+        p = dataframe::convert_dataframe (df);
+    }));
+
+    // Pipeline stages
+    surface_estimate se;
+    print (p.size (), "surface_estimate", measure (c, [&] { se = get_surface_estimate (p, params); }));
+
+    vector<vector<size_t>> h_bins;
+    print (p.size (), "binning", measure (c, [&] { h_bins = get_h_bins (p, params); }));
+
+    vector<estimates> e;
+    print (p.size (), "window_estimates", measure (c, [&] { e = get_window_estimates (p, se, h_bins, params); }));
+
+    // Overlapping windows at a quarter of the window length
+    //
+    // The work per cell does not depend on the window length, so this
+    // should take about four times as long as the disjoint windows.
+    auto sliding_params (params);
+    sliding_params.x_stride = params.x_resolution / 4.0;
+    auto cell_params (params);
+    cell_params.x_resolution = sliding_params.x_stride;
+    const auto cells = get_h_bins (p, cell_params);
+    vector<estimates> sliding;
+    print (p.size (), "sliding_estimates", measure (c, [&] { sliding = get_sliding_estimates (p, se, cells, sliding_params); }));
+
+    const auto smoothing = measure (c, [&]
+    {
+        get_smooth_estimates (p, h_bins, e, params.surface_smoothing_sigma,
+            [](const estimates &a) { return a.surface_elevation; });
+        get_smooth_estimates (p, h_bins, e, params.bathy_smoothing_sigma,
+            [](const estimates &a) { return a.bathy_elevation; });
+    });
+    print (p.size (), "smoothing", smoothing);
+
+    // Assignment includes the smoothing, so that is subtracted
+    vector<photon> q;
+    const auto assignment = measure (c, [&] { q = assign_estimates (p, h_bins, e, params); });
+    print (p.size (), "assignment", assignment - smoothing);
+
+    print (q.size (), "write", measure (c, [&]
+    {
+        ostringstream os;
+        write_predictions (os, q);
+    }));
+
+    // End-to-end, without I/O
+    print (p.size (), "classify", measure (c, [&] { q = classify (p, params); }));
+}
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        // Open the counters before OpenMP starts any threads
+        counters::counter_set c;
+        if (!c.available ())
+            clog << "Hardware counters are not available: " << c.get_error () << endl;
+
+        profile::count_allocations (true);
+
+        vector<size_t> sizes { 100'000, 1'000'000, 4'000'000 };
+
+        if (argc > 1)
+        {
+            sizes.clear ();
+            for (int i = 1; i < argc; ++i)
+                sizes.push_back (atol (argv[i]));
+        }
+
+        for (auto i : sizes)
+            if (i == 0)
+                throw runtime_error ("usage: " + usage);
+
+        print_header ();
+
+        for (auto i : sizes)
+            bench (c, i);
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -0,0 +1,320 @@
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/oopp.h"
+#include "oopp/synthetic.h"
+#include "oopp/timer.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"bench_io [-d directory] [megabytes1 megabytes2 ...]"};
+
+// Number of times each method is run. The fastest run is reported.
+const size_t reps = 3;
+
+/// @brief Write a predictions CSV file
+/// @param fn Filename
+/// @param bytes File size, rounded up to the end of a row
+/// @return Number of rows
+///
+/// The rows of one synthetic track are repeated until the file is
+/// large enough, so large files don't need a large track in memory.
+size_t make_file (const string &fn, const size_t bytes)
+{
+    synthetic::track_params tp;
+    tp.length = clamp (bytes / 50, size_t (1'000), size_t (1'000'000)) / tp.density;
+    const auto track = synthetic::get_track (tp);
+
+    stringstream ss;
+    write_predictions (ss, track);
+    const auto s = ss.str ();
+    const auto n = s.find ('\n') + 1;
+    const auto body = s.substr (n);
+
+    ofstream ofs (fn);
+    if (!ofs)
+        throw runtime_error ("Could not open file for writing");
+
+    ofs << s.substr (0, n);
+    size_t written = n;
+    size_t rows = 0;
+    while (written < bytes)
+    {
+        // End the last copy on the first line break past the size
+        const size_t remaining = bytes - written;
+        const auto end = remaining < body.size () ? body.find ('\n', remaining) + 1 : body.size ();
+        ofs.write (body.data (), end);
+        written += end;
+        rows += count (body.begin (), body.begin () + end, '\n');
+    }
+
+    if (!ofs)
+        throw runtime_error ("Could not write file");
+
+    return rows;
+}
+
+// Evict a file from the page cache, if the kernel lets us
+bool drop_cache (const string &fn)
+{
+    const int fd = open (fn.c_str (), O_RDONLY);
+    if (fd == -1)
+        return false;
+    fdatasync (fd);
+    const int rc = posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+    close (fd);
+    return rc == 0;
+}
+
+// A 'cat' process on the other end of a pipe
+//
+// When reading, 'cat' copies a file into the pipe. When writing, it
+// copies the pipe to /dev/null.
+class pipe_process
+{
+    public:
+    pipe_process (const string &fn, const bool reading)
+    {
+        int fds[2];
+        if (pipe (fds) != 0)
+            throw runtime_error ("Could not create a pipe");
+
+        // Our end of the pipe, and the child's
+        fd = reading ? fds[0] : fds[1];
+        const int child_fd = reading ? fds[1] : fds[0];
+
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init (&fa);
+        posix_spawn_file_actions_adddup2 (&fa, child_fd, reading ? 1 : 0);
+        if (!reading)
+            posix_spawn_file_actions_addopen (&fa, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addclose (&fa, fds[0]);
+        posix_spawn_file_actions_addclose (&fa, fds[1]);
+
+        string cmd ("cat");
+        string arg (fn);
+        char *argv[] = { cmd.data (), reading ? arg.data () : nullptr, nullptr };
+        const int rc = posix_spawnp (&pid, "cat", &fa, nullptr, argv, environ);
+        posix_spawn_file_actions_destroy (&fa);
+        close (child_fd);
+
+        if (rc != 0)
+        {
+            close (fd);
+            throw runtime_error ("Could not start 'cat'");
+        }
+    }
+    ~pipe_process ()
+    {
+        finish ();
+    }
+    pipe_process (const pipe_process &) = delete;
+    pipe_process &operator= (const pipe_process &) = delete;
+
+    // A path that opens our end of the pipe
+    string path () const { return "/dev/fd/" + to_string (fd); }
+
+    // Close our end and wait for 'cat' to finish
+    void finish ()
+    {
+        if (fd == -1)
+            return;
+        close (fd);
+        fd = -1;
+        waitpid (pid, nullptr, 0);
+    }
+
+    private:
+    pid_t pid;
+    int fd;
+};
+
+// Get the fastest of several runs of a function, in seconds
+template<typename F>
+double get_seconds (F f)
+{
+    double best = numeric_limits<double>::max ();
+    for (size_t i = 0; i < reps; ++i)
+        best = min (best, f ());
+    return best;
+}
+
+void print (const string &method, const string &target, const size_t bytes, const size_t rows, const double seconds)
+{
+    const double MB = 1 << 20;
+    cout << method
+        << "\t" << target
+        << "\t" << fixed << setprecision (1) << bytes / MB
+        << "\t" << rows
+        << "\t" << setprecision (6) << seconds
+        << "\t" << setprecision (1) << bytes / MB / seconds
+        << "\t" << setprecision (0) << rows / seconds
+        << endl;
+}
+
+// The ways that a file can be read
+enum class source { warm_file, cold_file, pipe };
+
+const vector<pair<string,source>> sources {
+    { "warm_file", source::warm_file },
+    { "cold_file", source::cold_file },
+    { "pipe", source::pipe } };
+
+/// @brief Time a reader
+/// @param fn File to read
+/// @param s How to read it
+/// @param f Function that reads a stream
+template<typename F>
+double time_read (const string &fn, const source s, F f)
+{
+    if (s == source::cold_file && !drop_cache (fn))
+        return numeric_limits<double>::quiet_NaN ();
+
+    if (s == source::warm_file)
+    {
+        // Make sure the file is cached
+        ifstream ifs (fn);
+        vector<char> buffer (1 << 20);
+        while (ifs.read (buffer.data (), buffer.size ()))
+        {
+        }
+    }
+
+    timer::timer t;
+    if (s == source::pipe)
+    {
+        pipe_process p (fn, true);
+        ifstream ifs (p.path ());
+        f (ifs);
+    }
+    else
+    {
+        ifstream ifs (fn);
+        f (ifs);
+    }
+    t.stop ();
+    return t.elapsed_ns () / 1'000'000'000;
+}
+
+/// @brief Time a writer
+/// @param fn File to write, or empty to write to a pipe
+/// @param f Function that writes a stream
+double time_write (const string &fn, const function<void(ostream &)> &f)
+{
+    timer::timer t;
+    if (fn.empty ())
+    {
+        pipe_process p (fn, false);
+        {
+            ofstream ofs (p.path ());
+            f (ofs);
+        }
+        p.finish ();
+    }
+    else
+    {
+        ofstream ofs (fn);
+        f (ofs);
+    }
+    t.stop ();
+    return t.elapsed_ns () / 1'000'000'000;
+}
+
+void bench (const string &dir, const size_t megabytes)
+{
+    const size_t bytes = megabytes << 20;
+    const auto fn = (filesystem::path (dir) / ("bench_io_" + to_string (megabytes) + "MB.csv")).string ();
+    const auto out = (filesystem::path (dir) / ("bench_io_" + to_string (megabytes) + "MB_out.csv")).string ();
+
+    const size_t rows = make_file (fn, bytes);
+    const size_t size = filesystem::file_size (fn);
+
+    const vector<string> names {
+        dataframe::PI_NAME,
+        dataframe::X_NAME,
+        dataframe::Z_NAME,
+        dataframe::LABEL_NAME,
+        dataframe::PREDICTION_NAME,
+        dataframe::SEA_SURFACE_NAME,
+        dataframe::BATHY_NAME };
+
+    // Readers
+    for (const auto &s : sources)
+    {
+        print ("read", s.first, size, rows, get_seconds ([&] {
+            return time_read (fn, s.second, [](istream &is) { dataframe::read (is); }); }));
+        print ("read_buffered", s.first, size, rows, get_seconds ([&] {
+            return time_read (fn, s.second, [](istream &is) { dataframe::read_buffered (is); }); }));
+        print ("read_columns", s.first, size, rows, get_seconds ([&] {
+            return time_read (fn, s.second, [&](istream &is) {
+                dataframe::read_columns (is, names, [](const vector<vector<double>> &) { }); }); }));
+    }
+
+    // Writers
+    const auto df = dataframe::read_buffered (fn);
+    const auto p = dataframe::convert_dataframe (df);
+
+    const vector<pair<string,function<void(ostream &)>>> writers {
+        { "write", [&](ostream &os) { dataframe::write (os, df); } },
+        { "write_predictions", [&](ostream &os) { write_predictions (os, p); } } };
+
+    for (const auto &w : writers)
+    {
+        // Writers format numbers differently, so their output sizes differ
+        const double seconds = get_seconds ([&] { return time_write (out, w.second); });
+        const size_t written = filesystem::file_size (out);
+        print (w.first, "file", written, rows, seconds);
+        print (w.first, "pipe", written, rows, get_seconds ([&] { return time_write (string (), w.second); }));
+    }
+
+    filesystem::remove (fn);
+    filesystem::remove (out);
+}
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        string dir = filesystem::temp_directory_path ().string ();
+
+        int c;
+        while ((c = getopt (argc, argv, "d:")) != -1)
+        {
+            if (c != 'd')
+                throw runtime_error ("usage: " + usage);
+            dir = optarg;
+        }
+
+        vector<size_t> sizes { 1, 16, 256 };
+
+        if (optind < argc)
+        {
+            sizes.clear ();
+            for (int i = optind; i < argc; ++i)
+                sizes.push_back (atol (argv[i]));
+        }
+
+        for (auto i : sizes)
+            if (i == 0)
+                throw runtime_error ("usage: " + usage);
+
+        cout << "method\ttarget\tMB\trows\tseconds\tMB_per_second\trows_per_second" << endl;
+
+        for (auto i : sizes)
+            bench (dir, i);
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -0,0 +1,176 @@
+#include "oopp/precompiled.h"
+#include "oopp/timer.h"
+#include "oopp/utils.h"
+
+using namespace std;
+using namespace oopp;
+
+const string usage {"bench_utils [kernel1 kernel2 ...]"};
+
+// Number of times each kernel is timed. The fastest time is reported.
+const size_t reps = 5;
+
+// Each timing runs a kernel at least this long, so that small inputs
+// get timed over many calls
+const double min_seconds = 0.05;
+
+// Keeps results alive, so that calls aren't optimized away
+volatile double sink = 0.0;
+
+// Get the time of one call of a function, in seconds
+template<typename F>
+double get_seconds (F f)
+{
+    // Find the number of calls that takes long enough to time
+    size_t calls = 1;
+    for (;;)
+    {
+        timer::timer t;
+        for (size_t i = 0; i < calls; ++i)
+            f ();
+        t.stop ();
+        if (t.elapsed_ns () / 1'000'000'000 >= min_seconds)
+            break;
+        calls *= 2;
+    }
+
+    double best = numeric_limits<double>::max ();
+    for (size_t i = 0; i < reps; ++i)
+    {
+        timer::timer t;
+        for (size_t j = 0; j < calls; ++j)
+            f ();
+        t.stop ();
+        best = min (best, t.elapsed_ns () / 1'000'000'000 / calls);
+    }
+    return best;
+}
+
+void print (const string &kernel, const size_t n, const double seconds)
+{
+    cout << kernel
+        << "\t" << n
+        << "\t" << scientific << setprecision (4) << seconds
+        << "\t" << fixed << setprecision (0) << (seconds == 0.0 ? 0.0 : n / seconds)
+        << endl;
+}
+
+// A histogram of elevations with a surface and a bathy peak
+vector<double> get_histogram (const size_t n, mt19937_64 &rng)
+{
+    normal_distribution<> surface (n * 0.75, n * 0.01);
+    normal_distribution<> bathy (n * 0.25, n * 0.03);
+    uniform_real_distribution<> noise (0.0, n);
+    vector<double> h (n);
+    const size_t samples = 100'000 + 4 * n;
+    for (size_t i = 0; i < samples; ++i)
+    {
+        const double r = i % 10 == 0 ? noise (rng) : (i % 3 == 0 ? bathy (rng) : surface (rng));
+        const long j = r;
+        if (j >= 0 && j < static_cast<long> (n))
+            ++h[j];
+    }
+    return h;
+}
+
+// Random values
+vector<double> get_values (const size_t n, mt19937_64 &rng)
+{
+    normal_distribution<> d (0.0, 10.0);
+    vector<double> x (n);
+    for (auto &i : x)
+        i = d (rng);
+    return x;
+}
+
+// Each kernel is run on a 401-bin histogram, like those of a window,
+// and on a million values, like a grid or a whole track
+const vector<size_t> sizes { 401, 1'000'000 };
+
+const map<string,function<void(const size_t, mt19937_64 &)>> kernels {
+    { "gaussian_1D_filter", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto h = get_histogram (n, rng);
+        print ("gaussian_1D_filter", n, get_seconds ([&] {
+            sink = sink + utils::gaussian_1D_filter (h, 2.0)[n / 2]; }));
+    } },
+    { "box_1D_filter", [](const size_t n, mt19937_64 &rng)
+    {
+        auto h = get_histogram (n, rng);
+        print ("box_1D_filter", n, get_seconds ([&] {
+            utils::box_1D_filter (h.begin (), h.end (), 5);
+            sink = sink + h[n / 2]; }));
+    } },
+    { "find_peaks", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto h = utils::gaussian_1D_filter (get_histogram (n, rng), 2.0);
+        print ("find_peaks", n, get_seconds ([&] {
+            sink = sink + utils::find_peaks (h).size (); }));
+    } },
+    { "median", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto x = get_values (n, rng);
+        print ("median", n, get_seconds ([&] {
+            sink = sink + utils::median (x); }));
+    } },
+    { "convert_to_pmf", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto h = get_histogram (n, rng);
+        print ("convert_to_pmf", n, get_seconds ([&] {
+            sink = sink + utils::convert_to_pmf (h)[n / 2]; }));
+    } },
+    { "mean", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto x = get_values (n, rng);
+        print ("mean", n, get_seconds ([&] {
+            sink = sink + utils::mean (x); }));
+    } },
+    { "variance", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto x = get_values (n, rng);
+        print ("variance", n, get_seconds ([&] {
+            sink = sink + utils::variance (x); }));
+    } },
+    { "z_score", [](const size_t n, mt19937_64 &rng)
+    {
+        const auto x = get_values (n, rng);
+        print ("z_score", n, get_seconds ([&] {
+            sink = sink + utils::z_score (x)[n / 2]; }));
+    } },
+};
+
+int main (int argc, char **argv)
+{
+    try
+    {
+        vector<string> names;
+        for (const auto &i : kernels)
+            names.push_back (i.first);
+
+        if (argc > 1)
+            names.assign (argv + 1, argv + argc);
+
+        for (const auto &i : names)
+            if (kernels.find (i) == kernels.end ())
+                throw runtime_error ("Unknown kernel '" + i + "', usage: " + usage);
+
+        cout << "kernel\tn\tseconds\telements_per_second" << endl;
+
+        for (const auto &i : names)
+        {
+            for (auto n : sizes)
+            {
+                // Every kernel gets the same inputs
+                mt19937_64 rng (n);
+                kernels.at (i) (n, rng);
+            }
+        }
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
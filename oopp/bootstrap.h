@@ -0,0 +1,196 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/confusion.h"
+#include "oopp/scoring.h"
+
+namespace oopp
+{
+
+namespace bootstrap
+{
+
+// The metrics that get intervals, in the order that they are reported
+const std::vector<std::string> metric_names { "acc", "F1", "bal_acc", "cal_F1", "MCC" };
+
+// A point estimate and its confidence interval
+struct interval
+{
+    double estimate;
+    double lower;
+    double upper;
+};
+
+// Intervals for each metric of a row
+struct row
+{
+    std::string name;
+    std::vector<interval> intervals;
+};
+
+/// @brief Get the names of the rows that get intervals
+/// @param classes Classes that were scored
+/// @param weighted Add a row for the weighted scores
+std::vector<std::string> get_row_names (const std::vector<long> &classes, const bool weighted)
+{
+    std::vector<std::string> names;
+    for (auto c : classes)
+        names.push_back (std::to_string (c));
+    if (weighted)
+        names.push_back ("weighted");
+    return names;
+}
+
+/// @brief Get all metrics of a matrix, one row per class
+/// @param m Multi-class matrix
+/// @param weighted Add a row for the weighted scores
+/// @return Row-major metrics
+std::vector<double> get_metrics (const multiclass_confusion_matrix &m, const bool weighted)
+{
+    std::vector<double> x;
+    const auto cms = scoring::get_confusion_matrices (m);
+    for (const auto &i : cms)
+    {
+        const auto &cm = i.second;
+        x.push_back (cm.accuracy ());
+        x.push_back (cm.F1 ());
+        x.push_back (cm.balanced_accuracy ());
+        x.push_back (cm.calibrated_F_beta ());
+        x.push_back (cm.MCC ());
+    }
+    if (weighted)
+    {
+        const auto w = scoring::get_weighted_scores (cms);
+        x.push_back (w.accuracy);
+        x.push_back (w.F1);
+        x.push_back (w.bal_acc);
+        x.push_back (w.cal_F1);
+        x.push_back (w.MCC);
+    }
+    return x;
+}
+
+/// @brief Sum blocks drawn with replacement
+/// @param blocks Per-block counts
+/// @param rng Random number generator
+/// @return A matrix with as many blocks as the original
+template<typename T>
+multiclass_confusion_matrix resample (const std::vector<multiclass_confusion_matrix> &blocks, T &rng)
+{
+    assert (!blocks.empty ());
+
+    multiclass_confusion_matrix m (blocks[0].get_classes ());
+    std::uniform_int_distribution<size_t> d (0, blocks.size () - 1);
+    for (size_t i = 0; i < blocks.size (); ++i)
+        m.add (blocks[d (rng)]);
+    return m;
+}
+
+/// @brief Get a percentile of a set of values
+/// @param x Values, NaNs are ignored
+/// @param p Percentile, between 0.0 and 1.0
+/// @return Linearly interpolated percentile, or NaN if there are no values
+double percentile (std::vector<double> x, const double p)
+{
+    using namespace std;
+
+    assert (p >= 0.0 && p <= 1.0);
+
+    erase_if (x, [](const double i) { return isnan (i); });
+
+    if (x.empty ())
+        return numeric_limits<double>::quiet_NaN ();
+
+    sort (x.begin (), x.end ());
+    const double i = p * (x.size () - 1);
+    const size_t j = floor (i);
+    const size_t k = ceil (i);
+    return x[j] + (i - j) * (x[k] - x[j]);
+}
+
+/// @brief Get bootstrap confidence intervals by resampling blocks
+/// @param blocks Per-block counts, for example one per file
+/// @param replicates Number of bootstrap replicates
+/// @param confidence Confidence level, for example 0.95
+/// @param seed Random seed
+/// @param weighted Add a row for the weighted scores
+///
+/// Each replicate is a sum of resampled block counts, so no photons
+/// are rescored. Replicate 'i' is seeded with 'seed + i', so results
+/// don't depend on the number of threads.
+std::vector<row> get_intervals (const std::vector<multiclass_confusion_matrix> &blocks,
+    const size_t replicates,
+    const double confidence,
+    const uint64_t seed,
+    const bool weighted)
+{
+    using namespace std;
+
+    // Resampling a single block always gives it back
+    if (blocks.size () < 2)
+        throw runtime_error ("There must be at least two blocks to resample");
+    if (confidence <= 0.0 || confidence >= 1.0)
+        throw runtime_error ("Confidence must be between 0 and 1");
+
+    // Point estimates
+    multiclass_confusion_matrix total (blocks[0].get_classes ());
+    for (const auto &b : blocks)
+        total.add (b);
+    const auto estimates = get_metrics (total, weighted);
+
+    // Replicates
+    vector<vector<double>> values (estimates.size (), vector<double> (replicates));
+
+#pragma omp parallel for
+    for (size_t i = 0; i < replicates; ++i)
+    {
+        mt19937_64 rng (seed + i);
+        const auto x = get_metrics (resample (blocks, rng), weighted);
+        for (size_t j = 0; j < x.size (); ++j)
+            values[j][i] = x[j];
+    }
+
+    // Percentile intervals
+    const double alpha = (1.0 - confidence) / 2.0;
+    vector<row> rows;
+    const auto names = get_row_names (total.get_classes (), weighted);
+    for (size_t i = 0; i < names.size (); ++i)
+    {
+        row r { names[i], {} };
+        for (size_t j = 0; j < metric_names.size (); ++j)
+        {
+            const size_t k = i * metric_names.size () + j;
+            r.intervals.push_back (interval {
+                estimates[k],
+                percentile (values[k], alpha),
+                percentile (values[k], 1.0 - alpha) });
+        }
+        rows.push_back (r);
+    }
+
+    return rows;
+}
+
+std::string get_header ()
+{
+    return "cls\tmetric\testimate\tlower\tupper";
+}
+
+std::string print (const std::vector<row> &rows)
+{
+    std::stringstream ss;
+    ss << std::setprecision(3) << std::fixed;
+    for (const auto &r : rows)
+        for (size_t j = 0; j < metric_names.size (); ++j)
+            ss << r.name
+                << "\t" << metric_names[j]
+                << "\t" << r.intervals[j].estimate
+                << "\t" << r.intervals[j].lower
+                << "\t" << r.intervals[j].upper
+                << std::endl;
+    return ss.str ();
+}
+
+} // namespace bootstrap
+
+} // namespace oopp
@@ -0,0 +1,341 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/oopp.h"
+
+#include <unistd.h>
+
+namespace oopp
+{
+
+namespace cache
+{
+
+// Change this when a change to the classifier changes its predictions,
+// so that old entries are no longer found
+const uint32_t VERSION = 1;
+
+const std::string MAGIC = std::string ("OOPPCACHE");
+const std::string EXTENSION = std::string (".bin");
+const std::string TEMPORARY = std::string (".tmp.");
+
+// 64-bit FNV-1a hash
+class hasher
+{
+    public:
+    void update (const void *data, const size_t n)
+    {
+        const auto p = reinterpret_cast<const unsigned char *> (data);
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= p[i];
+            h *= 0x100000001b3ull;
+        }
+    }
+    template<typename T>
+    void update (const T &x)
+    {
+        update (&x, sizeof (T));
+    }
+    uint64_t get () const { return h; }
+
+    private:
+    uint64_t h = 0xcbf29ce484222325ull;
+};
+
+/// @brief Hash the photon fields that classification depends on
+template<typename T>
+void update (hasher &h, const T &p)
+{
+    for (const auto &i : p)
+    {
+        h.update (static_cast<uint64_t> (i.h5_index));
+        h.update (i.x);
+        h.update (i.z);
+    }
+}
+
+/// @brief Get the key of a track's predictions
+/// @param p Photons
+/// @param params Parameters
+/// @return Hexadecimal hash of the inputs and parameters, and the number of photons
+///
+/// Only the photon fields that classification depends on are hashed,
+/// so the key does not depend on how the input file was formatted.
+template<typename T,typename U>
+std::string get_key (const T &p, const U &params)
+{
+    using namespace std;
+
+    hasher h;
+    h.update (VERSION);
+
+    h.update (params.x_resolution);
+    h.update (params.z_resolution);
+    h.update (params.z_min);
+    h.update (params.z_max);
+    h.update (params.surface_z_min);
+    h.update (params.surface_z_max);
+    h.update (params.bathy_min_depth);
+    h.update (params.vertical_smoothing_sigma);
+    h.update (params.surface_smoothing_sigma);
+    h.update (params.bathy_smoothing_sigma);
+    h.update (params.min_peak_prominence);
+    h.update (static_cast<uint64_t> (params.min_peak_distance));
+    h.update (static_cast<uint64_t> (params.min_surface_photons_per_window));
+    h.update (static_cast<uint64_t> (params.min_bathy_photons_per_window));
+    h.update (params.surface_n_stddev);
+    h.update (params.bathy_n_stddev);
+    h.update (params.x_stride);
+
+    update (h, p);
+
+    stringstream ss;
+    ss << hex << setfill ('0') << setw (16) << h.get () << "-" << dec << p.size ();
+    return ss.str ();
+}
+
+// A directory of classified tracks, keyed by get_key()
+//
+// Each entry holds the prediction columns of one track. Reading an
+// entry updates its modification time, and when the entries take up
+// more than 'max_bytes', the least recently used ones are removed.
+// Entries are written to a temporary file and renamed, so several
+// processes can share a directory.
+//
+// The directory is scanned once when the cache is opened, and an index
+// of entry sizes and times is kept up to date as entries are read,
+// written and removed. Entries written by other processes are indexed
+// when they are first read, or by the next call to evict().
+class cache
+{
+    public:
+    cache (const std::string &directory, const uintmax_t size_limit)
+        : dir (directory)
+        , max_bytes (size_limit)
+    {
+        std::filesystem::create_directories (dir);
+        evict ();
+    }
+
+    /// @brief Get a track's predictions
+    /// @param key Key from get_key()
+    /// @param p Photons whose prediction columns are filled in
+    /// @return True if the track was found
+    template<typename T>
+    bool get (const std::string &key, T &p)
+    {
+        using namespace std;
+
+        const auto fn = get_filename (key);
+        ifstream ifs (fn, ios::binary);
+        if (!ifs || !read (ifs, p))
+        {
+            ++n_misses;
+            return false;
+        }
+
+        // Mark it as recently used
+        const auto now = filesystem::file_time_type::clock::now ();
+        error_code ec;
+        filesystem::last_write_time (fn, now, ec);
+
+        {
+            lock_guard<mutex> lock (m);
+            add_entry (fn, now);
+        }
+
+        ++n_hits;
+        return true;
+    }
+
+    /// @brief Save a track's predictions
+    /// @param key Key from get_key()
+    /// @param p Classified photons
+    template<typename T>
+    void put (const std::string &key, const T &p)
+    {
+        using namespace std;
+
+        const auto fn = get_filename (key);
+        const auto tmp = fn.string () + TEMPORARY + to_string (getpid ()) + "." + to_string (omp_get_thread_num ());
+        error_code ec;
+        {
+            ofstream ofs (tmp, ios::binary);
+            if (!ofs || !write (ofs, p))
+            {
+                filesystem::remove (tmp, ec);
+                throw runtime_error ("Could not write cache entry");
+            }
+        }
+        filesystem::rename (tmp, fn, ec);
+        if (ec)
+        {
+            filesystem::remove (tmp, ec);
+            throw runtime_error ("Could not write cache entry");
+        }
+
+        lock_guard<mutex> lock (m);
+        add_entry (fn, filesystem::file_time_type::clock::now ());
+        shrink ();
+    }
+
+    /// @brief Rescan the directory and remove the least recently used
+    /// entries until the cache fits
+    ///
+    /// Temporary files that were left behind by a process that stopped
+    /// while writing an entry are removed once they are an hour old.
+    void evict ()
+    {
+        using namespace std;
+
+        lock_guard<mutex> lock (m);
+
+        index.clear ();
+        total_bytes = 0;
+
+        const auto stale = filesystem::file_time_type::clock::now () - chrono::hours (1);
+        error_code ec;
+        for (const auto &i : filesystem::directory_iterator (dir, ec))
+        {
+            const auto time = i.last_write_time (ec);
+            if (ec)
+                continue;
+            if (i.path ().extension () == EXTENSION)
+                add_entry (i.path (), time);
+            else if (i.path ().filename ().string ().find (EXTENSION + TEMPORARY) != string::npos && time < stale)
+                filesystem::remove (i.path (), ec);
+        }
+
+        shrink ();
+    }
+
+    size_t hits () const { return n_hits; }
+    size_t misses () const { return n_misses; }
+    size_t evictions () const { return n_evictions; }
+
+    private:
+    struct entry
+    {
+        uintmax_t bytes = 0;
+        std::filesystem::file_time_type time;
+    };
+
+    const std::filesystem::path dir;
+    const uintmax_t max_bytes;
+    std::atomic<size_t> n_hits = 0;
+    std::atomic<size_t> n_misses = 0;
+    std::atomic<size_t> n_evictions = 0;
+
+    // Guards the index
+    std::mutex m;
+    std::unordered_map<std::string,entry> index;
+    uintmax_t total_bytes = 0;
+
+    // Add or update an entry, with the mutex held
+    void add_entry (const std::filesystem::path &fn, const std::filesystem::file_time_type time)
+    {
+        std::error_code ec;
+        const auto bytes = std::filesystem::file_size (fn, ec);
+        if (ec)
+            return;
+        auto &e = index[fn.filename ().string ()];
+        total_bytes = total_bytes - e.bytes + bytes;
+        e.bytes = bytes;
+        e.time = time;
+    }
+
+    // Remove the least recently used entries, with the mutex held
+    void shrink ()
+    {
+        using namespace std;
+
+        if (total_bytes <= max_bytes)
+            return;
+
+        vector<unordered_map<string,entry>::iterator> entries;
+        entries.reserve (index.size ());
+        for (auto i = index.begin (); i != index.end (); ++i)
+            entries.push_back (i);
+
+        sort (entries.begin (), entries.end (),
+            [](const auto &a, const auto &b) { return a->second.time < b->second.time; });
+
+        error_code ec;
+        for (const auto &i : entries)
+        {
+            if (total_bytes <= max_bytes)
+                break;
+            if (filesystem::remove (dir / i->first, ec))
+                ++n_evictions;
+            total_bytes -= i->second.bytes;
+            index.erase (i);
+        }
+    }
+
+    std::filesystem::path get_filename (const std::string &key) const
+    {
+        return dir / (key + EXTENSION);
+    }
+
+    // Predictions are stored as bytes, and elevations as doubles so
+    // that cached output matches computed output exactly
+    template<typename T>
+    static bool write (std::ostream &os, const T &p)
+    {
+        os.write (MAGIC.data (), MAGIC.size ());
+        os.write (reinterpret_cast<const char *> (&VERSION), sizeof (VERSION));
+        const uint64_t n = p.size ();
+        os.write (reinterpret_cast<const char *> (&n), sizeof (n));
+
+        std::vector<uint8_t> prediction (p.size ());
+        std::vector<double> surface (p.size ());
+        std::vector<double> bathy (p.size ());
+        for (size_t i = 0; i < p.size (); ++i)
+        {
+            assert (p[i].prediction <= std::numeric_limits<uint8_t>::max ());
+            prediction[i] = p[i].prediction;
+            surface[i] = p[i].surface_elevation;
+            bathy[i] = p[i].bathy_elevation;
+        }
+        os.write (reinterpret_cast<const char *> (prediction.data ()), n * sizeof (uint8_t));
+        os.write (reinterpret_cast<const char *> (surface.data ()), n * sizeof (double));
+        os.write (reinterpret_cast<const char *> (bathy.data ()), n * sizeof (double));
+        return static_cast<bool> (os);
+    }
+
+    // An entry that can't be read is treated as missing
+    template<typename T>
+    static bool read (std::istream &is, T &p)
+    {
+        std::string magic (MAGIC.size (), ' ');
+        uint32_t version = 0;
+        uint64_t n = 0;
+        is.read (magic.data (), magic.size ());
+        is.read (reinterpret_cast<char *> (&version), sizeof (version));
+        is.read (reinterpret_cast<char *> (&n), sizeof (n));
+        if (!is || magic != MAGIC || version != VERSION || n != p.size ())
+            return false;
+
+        std::vector<uint8_t> prediction (n);
+        std::vector<double> surface (n);
+        std::vector<double> bathy (n);
+        is.read (reinterpret_cast<char *> (prediction.data ()), n * sizeof (uint8_t));
+        is.read (reinterpret_cast<char *> (surface.data ()), n * sizeof (double));
+        is.read (reinterpret_cast<char *> (bathy.data ()), n * sizeof (double));
+        if (!is)
+            return false;
+
+        for (size_t i = 0; i < p.size (); ++i)
+        {
+            p[i].prediction = prediction[i];
+            p[i].surface_elevation = surface[i];
+            p[i].bathy_elevation = bathy[i];
+        }
+        return true;
+    }
+};
+
+} // namespace cache
+
+} // namespace oopp
@@ -32,6 +32,74 @@ void print_help (std::ostream &os, const std::string &usage, const size_t noptio
     }
 }
 
+/// @brief Parse a comma separated list of values
+std::vector<double> parse_list (const std::string &s)
+{
+    std::vector<double> values;
+    std::stringstream ss (s);
+    std::string value;
+    while (getline (ss, value, ','))
+    {
+        if (value.empty ())
+            throw std::runtime_error ("Invalid list: '" + s + "'");
+        values.push_back (atof (value.c_str ()));
+    }
+    if (values.empty ())
+        throw std::runtime_error ("Empty list");
+    return values;
+}
+
+/// @brief Read a list of filenames, one per line
+/// @param fn File to read, or '-' to read stdin
+std::vector<std::string> read_filenames (const std::string &fn)
+{
+    using namespace std;
+
+    ifstream ifs;
+    if (fn != "-")
+    {
+        ifs.open (fn);
+        if (!ifs)
+            throw runtime_error ("Could not open file for reading");
+    }
+    istream &is = (fn == "-") ? cin : ifs;
+
+    vector<string> filenames;
+    string line;
+    while (getline (is, line))
+    {
+        erase (line, '\r');
+        if (!line.empty ())
+            filenames.push_back (line);
+    }
+
+    return filenames;
+}
+
+/// @brief Order files from largest to smallest
+/// @param filenames Files to order
+/// @return Indexes into 'filenames'
+///
+/// Starting the largest files first keeps a few large files from
+/// being left for last. Files that can't be read are ordered last.
+std::vector<size_t> get_largest_first (const std::vector<std::string> &filenames)
+{
+    std::vector<uintmax_t> sizes (filenames.size ());
+    for (size_t i = 0; i < filenames.size (); ++i)
+    {
+        std::error_code ec;
+        const auto sz = std::filesystem::file_size (filenames[i], ec);
+        sizes[i] = ec ? 0 : sz;
+    }
+
+    std::vector<size_t> order (filenames.size ());
+    std::iota (order.begin (), order.end (), 0);
+    std::stable_sort (order.begin (), order.end (),
+        [&](const size_t a, const size_t b) { return sizes[a] > sizes[b]; });
+
+    return order;
+}
+
 } // namespace cmd
 
 } // namespace oopp
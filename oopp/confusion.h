@@ -5,14 +5,25 @@
 namespace oopp
 {
 
+// A binary confusion matrix
+//
+// Counts are exact integers, so they can be merged across any number
+// of files without losing precision. Metrics are computed in double.
 class confusion_matrix
 {
     public:
     confusion_matrix ()
-        : tp (0.0)
-        , tn (0.0)
-        , fp (0.0)
-        , fn (0.0)
+        : tp (0)
+        , tn (0)
+        , fp (0)
+        , fn (0)
+    {
+    }
+    confusion_matrix (const uint64_t n_tp, const uint64_t n_tn, const uint64_t n_fp, const uint64_t n_fn)
+        : tp (n_tp)
+        , tn (n_tn)
+        , fp (n_fp)
+        , fn (n_fn)
     {
     }
 
@@ -26,12 +37,12 @@ class confusion_matrix
     }
 
     // Matrix count access functions
-    size_t true_positives () const { return static_cast<size_t> (tp); }
-    size_t true_negatives () const { return static_cast<size_t> (tn); }
-    size_t false_positives () const { return static_cast<size_t> (fp); }
-    size_t false_negatives () const { return static_cast<size_t> (fn); }
-    size_t support () const { return static_cast<size_t> (tp + fn); }
-    size_t total () const { return static_cast<size_t> (tp + tn + fp + fn); }
+    uint64_t true_positives () const { return tp; }
+    uint64_t true_negatives () const { return tn; }
+    uint64_t false_positives () const { return fp; }
+    uint64_t false_negatives () const { return fn; }
+    uint64_t support () const { return tp + fn; }
+    uint64_t total () const { return tp + tn + fp + fn; }
 
     /// @brief Update the matrix
     /// @param present Truth value. True if class is present.
@@ -48,26 +59,23 @@ class confusion_matrix
     /// @param m Add matrix counts to this matrix's counts
     void update (const confusion_matrix &m)
     {
-        tp += m.tp;
-        tn += m.tn;
-        fp += m.fp;
-        fn += m.fn;
+        add (m);
     }
 
-    double accuracy () const { return (tp + tn) / (tp + tn + fp + fn); }
+    double accuracy () const { return ratio (tp + tn, total ()); }
     double precision () const { return positive_predictive_value (); }
     double recall () const { return true_positive_rate (); }
     double sensitivity () const { return true_positive_rate (); }
-    double true_positive_rate () const { return tp / (tp + fn); }
+    double true_positive_rate () const { return ratio (tp, tp + fn); }
     double specificity () const { return true_negative_rate (); }
-    double true_negative_rate () const { return tn / (fp + tn); }
-    double positive_predictive_value () const { return tp / (tp + fp); }
-    double negative_predictive_value () const { return tn / (tn + fn); }
+    double true_negative_rate () const { return ratio (tn, fp + tn); }
+    double positive_predictive_value () const { return ratio (tp, tp + fp); }
+    double negative_predictive_value () const { return ratio (tn, tn + fn); }
     double fallout () const { return false_positive_rate (); }
-    double false_positive_rate () const { return fp / (fp + tn); }
-    double false_discovery_rate () const { return fp / (fp + tp); }
+    double false_positive_rate () const { return ratio (fp, fp + tn); }
+    double false_discovery_rate () const { return ratio (fp, fp + tp); }
     double miss_rate () const { return false_negative_rate (); }
-    double false_negative_rate () const { return fn / (fn + tp); }
+    double false_negative_rate () const { return ratio (fn, fn + tp); }
 
     // The harmonic mean of precision and sensitivity
     double F1 () const { return 2.0 * precision () * recall () / (precision () + recall ()); }
@@ -95,9 +103,14 @@ class confusion_matrix
     // The correlation coefficient between the observed and predicted classifications
     double MCC () const
     {
-        const double x = (tp + fp) * (tp + fn) * (tn + fp) * (tn + fn);
+        // The products overflow integers, so they are done in double
+        const double d_tp = tp;
+        const double d_tn = tn;
+        const double d_fp = fp;
+        const double d_fn = fn;
+        const double x = (d_tp + d_fp) * (d_tp + d_fn) * (d_tn + d_fp) * (d_tn + d_fn);
         if (x > 0.0)
-            return (tp * tn - fp * fn) / sqrt (x);
+            return (d_tp * d_tn - d_fp * d_fn) / sqrt (x);
         else
             return 0.0;
     }
@@ -114,10 +127,120 @@ class confusion_matrix
     }
 
     private:
-    double tp;
-    double tn;
-    double fp;
-    double fn;
+    uint64_t tp;
+    uint64_t tn;
+    uint64_t fp;
+    uint64_t fn;
+
+    static double ratio (const uint64_t a, const uint64_t b)
+    {
+        return static_cast<double> (a) / static_cast<double> (b);
+    }
+};
+
+// A confusion matrix for several classes
+//
+// Rows are truth labels and columns are predictions. Labels that are
+// not one of the classes are counted in an extra 'other' row and
+// column, so that one-vs-rest matrices can be derived for each class.
+class multiclass_confusion_matrix
+{
+    public:
+    multiclass_confusion_matrix ()
+        : multiclass_confusion_matrix (std::vector<long> ())
+    {
+    }
+    explicit multiclass_confusion_matrix (const std::vector<long> &c)
+        : classes (c)
+        , n (c.size () + 1)
+        , lookup (256, c.size ())
+        , counts (n * n)
+    {
+        // Small labels are looked up in a table
+        for (size_t i = 0; i < classes.size (); ++i)
+            if (classes[i] >= 0 && classes[i] < static_cast<long> (lookup.size ()))
+                lookup[classes[i]] = i;
+    }
+
+    const std::vector<long> &get_classes () const { return classes; }
+
+    // Number of rows and columns, including 'other'
+    size_t size () const { return n; }
+
+    // Get the row/column index of a label
+    size_t get_index (const long label) const
+    {
+        if (label >= 0 && label < static_cast<long> (lookup.size ()))
+            return lookup[label];
+        const auto it = std::find (classes.begin (), classes.end (), label);
+        return it - classes.begin ();
+    }
+
+    /// @brief Update the matrix
+    /// @param actual Row index of the truth label
+    /// @param pred Column index of the prediction
+    void update (const size_t actual, const size_t pred)
+    {
+        assert (actual < n);
+        assert (pred < n);
+        ++counts[actual * n + pred];
+    }
+
+    // Add a matrix to this one
+    void add (const multiclass_confusion_matrix &m)
+    {
+        assert (m.classes == classes);
+        for (size_t i = 0; i < counts.size (); ++i)
+            counts[i] += m.counts[i];
+    }
+
+    // Row-major counts, for use in reductions
+    uint64_t *data () { return counts.data (); }
+    const uint64_t *data () const { return counts.data (); }
+
+    uint64_t count (const size_t actual, const size_t pred) const
+    {
+        assert (actual < n);
+        assert (pred < n);
+        return counts[actual * n + pred];
+    }
+    uint64_t total () const
+    {
+        return std::accumulate (counts.begin (), counts.end (), uint64_t (0));
+    }
+
+    // Get the one-vs-rest matrix for a class
+    confusion_matrix get_confusion_matrix (const long cls) const
+    {
+        const size_t k = get_index (cls);
+        assert (k < classes.size ());
+        uint64_t row = 0;
+        uint64_t col = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            row += count (k, i);
+            col += count (i, k);
+        }
+        const uint64_t tp = count (k, k);
+        const uint64_t fn = row - tp;
+        const uint64_t fp = col - tp;
+        const uint64_t tn = total () - tp - fn - fp;
+        return confusion_matrix (tp, tn, fp, fn);
+    }
+
+    private:
+    std::vector<long> classes;
+    size_t n;
+    std::vector<size_t> lookup;
+    std::vector<uint64_t> counts;
 };
 
+// Merge multi-class matrices in OpenMP reductions, for example:
+//
+//     #pragma omp parallel for reduction(+:m)
+//
+// Each thread starts with an empty matrix for the same classes.
+#pragma omp declare reduction(+ : multiclass_confusion_matrix : omp_out.add (omp_in)) \
+    initializer (omp_priv = multiclass_confusion_matrix (omp_orig.get_classes ()))
+
 } // namespace oopp
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace oopp
+{
+
+namespace counters
+{
+
+// The hardware events that are counted, in the order that they are reported
+enum event : size_t
+{
+    cycles,
+    instructions,
+    L1d_misses,
+    LLC_misses,
+    branch_misses,
+    event_count
+};
+
+const std::vector<std::string> event_names {
+    "cycles",
+    "instructions",
+    "L1d_misses",
+    "LLC_misses",
+    "branch_misses" };
+
+// Event counts, NaN where a counter is not available
+using values = std::array<double, event_count>;
+
+// Instructions per cycle
+double IPC (const values &v)
+{
+    return v[instructions] / v[cycles];
+}
+
+// Hardware performance counters for this process
+//
+// Counters are opened with 'inherit' set, so they also count threads
+// that are created after they are opened. OpenMP starts its threads at
+// the first parallel region, so the counters should be opened before
+// that, for example at the start of main.
+//
+// Opening a counter fails on systems that are not Linux, in virtual
+// machines without a PMU, and when perf_event_paranoid forbids it. The
+// other counters still work, and the missing ones read as NaN.
+class counter_set
+{
+    public:
+    counter_set ()
+    {
+        fds.fill (-1);
+#ifdef __linux__
+        const std::array<std::pair<uint32_t,uint64_t>, event_count> events {{
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES } }};
+
+        for (size_t i = 0; i < event_count; ++i)
+        {
+            perf_event_attr attr {};
+            attr.size = sizeof (attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            // Counters may be multiplexed, so the counts get scaled
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            fds[i] = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[i] == -1 && error.empty ())
+                error = event_names[i] + ": " + std::strerror (errno);
+        }
+#else
+        error = "Hardware counters are only supported on Linux";
+#endif
+    }
+    ~counter_set ()
+    {
+#ifdef __linux__
+        for (auto fd : fds)
+            if (fd != -1)
+                close (fd);
+#endif
+    }
+    counter_set (const counter_set &) = delete;
+    counter_set &operator= (const counter_set &) = delete;
+
+    // Whether any counter could be opened
+    bool available () const
+    {
+        return std::any_of (fds.begin (), fds.end (), [](const int fd) { return fd != -1; });
+    }
+
+    // Why the first counter that failed could not be opened
+    const std::string &get_error () const { return error; }
+
+    // Reset and start all counters
+    void start ()
+    {
+#ifdef __linux__
+        for (auto fd : fds)
+        {
+            if (fd == -1)
+                continue;
+            ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Stop all counters and read them
+    values stop ()
+    {
+        values v;
+        v.fill (std::numeric_limits<double>::quiet_NaN ());
+#ifdef __linux__
+        for (auto fd : fds)
+            if (fd != -1)
+                ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (size_t i = 0; i < event_count; ++i)
+        {
+            if (fds[i] == -1)
+                continue;
+
+            // Value, time enabled, time running
+            uint64_t x[3];
+            if (read (fds[i], x, sizeof (x)) != sizeof (x) || x[2] == 0)
+                continue;
+
+            v[i] = static_cast<double> (x[0]) * x[1] / x[2];
+        }
+#endif
+        return v;
+    }
+
+    private:
+    std::array<int, event_count> fds;
+    std::string error;
+};
+
+} // namespace counters
+
+} // namespace oopp
@@ -259,6 +259,114 @@ dataframe read_buffered (const std::string &fn)
     return oopp::dataframe::read_buffered (ifs);
 }
 
+/// @brief Read selected columns in fixed-size chunks
+/// @param is Input stream
+/// @param names Names of the columns to read, which must be distinct
+/// @param f Function that gets called with the values in each chunk, one vector per column
+/// @param chunk_size Maximum number of rows in a chunk
+/// @return Whether each column was found
+///
+/// Only the selected columns are parsed, and no more than one chunk
+/// is kept in memory. Columns that are not found are read as zeroes.
+template<typename F>
+std::vector<bool> read_columns (std::istream &is,
+    const std::vector<std::string> &names,
+    F f,
+    const size_t chunk_size = 1 << 16)
+{
+    using namespace std;
+
+    assert (chunk_size != 0);
+
+    // Read the headers
+    string line;
+    vector<bool> found (names.size ());
+
+    if (!getline (is, line))
+        return found;
+
+    // Get the selected column for each header, if any
+    vector<int> selected;
+    stringstream ss (line);
+    string header;
+    while (getline (ss, header, ','))
+    {
+        // Remove LFs in case the file was created under Windows
+        erase (header, '\r');
+
+        const auto it = find (names.begin (), names.end (), header);
+        if (it == names.end ())
+        {
+            selected.push_back (-1);
+            continue;
+        }
+        const size_t j = it - names.begin ();
+        found[j] = true;
+        selected.push_back (j);
+    }
+
+    // We don't need to look past this column
+    size_t last_column = 0;
+    for (size_t i = 0; i < selected.size (); ++i)
+        if (selected[i] != -1)
+            last_column = i + 1;
+
+    vector<vector<double>> values (names.size ());
+
+    // Now get the rows
+    vector<string> lines (chunk_size);
+    bool done = false;
+    while (!done)
+    {
+        // Read the chunk
+        size_t rows = 0;
+        while (rows < chunk_size)
+        {
+            if (!getline (is, lines[rows]))
+            {
+                done = true;
+                break;
+            }
+
+            // Skip empty lines
+            if (lines[rows].empty ())
+                continue;
+
+            ++rows;
+        }
+
+        for (auto &v : values)
+            v.assign (rows, 0.0);
+
+        // Parse it. This uses the calling thread's OpenMP thread count.
+#pragma omp parallel for
+        for (size_t i = 0; i < rows; ++i)
+        {
+            const char *p = lines[i].c_str ();
+            for (size_t j = 0; j < last_column && *p != '\0'; ++j)
+            {
+                if (selected[j] != -1)
+                {
+                    char *end;
+                    values[selected[j]][i] = strtod (p, &end);
+                    p = end;
+                }
+
+                // Skip to the next column
+                while (*p != ',' && *p != '\0')
+                    ++p;
+                if (*p == ',')
+                    ++p;
+            }
+        }
+
+        if (rows != 0)
+            f (values);
+    }
+
+    return found;
+}
+
 std::ostream &write (std::ostream &os, const dataframe &df, const size_t precision = 16)
 {
     using namespace std;
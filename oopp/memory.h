@@ -0,0 +1,71 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace oopp
+{
+
+namespace memory
+{
+
+/// @brief Get the resident set size of this process
+/// @return Bytes, or 0 if it can't be read
+uint64_t get_rss ()
+{
+#ifdef __linux__
+    // Sizes are in pages, and resident is the second field
+    std::ifstream ifs ("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (ifs >> size >> resident)
+        return resident * sysconf (_SC_PAGESIZE);
+#endif
+    return 0;
+}
+
+/// @brief Get the peak resident set size of this process
+/// @return Bytes, or 0 if it can't be read
+///
+/// The peak is taken since the process started or since the last call
+/// to reset_peak_rss ().
+uint64_t get_peak_rss ()
+{
+#ifdef __linux__
+    std::ifstream ifs ("/proc/self/status");
+    std::string line;
+    while (getline (ifs, line))
+    {
+        if (!line.starts_with ("VmHWM:"))
+            continue;
+        std::stringstream ss (line.substr (6));
+        uint64_t kb = 0;
+        if (ss >> kb)
+            return kb * 1024;
+    }
+#endif
+    return 0;
+}
+
+/// @brief Reset the peak resident set size to the current size
+/// @return True if the peak was reset
+///
+/// This needs Linux 4.0 or later.
+bool reset_peak_rss ()
+{
+#ifdef __linux__
+    std::ofstream ofs ("/proc/self/clear_refs");
+    ofs << "5";
+    ofs.close ();
+    return !ofs.fail ();
+#else
+    return false;
+#endif
+}
+
+} // namespace memory
+
+} // namespace oopp
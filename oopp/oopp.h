@@ -1,6 +1,8 @@
 #pragma once
 
 #include "oopp/precompiled.h"
+#include "oopp/profile.h"
+#include "oopp/trace.h"
 #include "oopp/utils.h"
 
 namespace oopp
@@ -77,6 +79,7 @@ struct params
     size_t min_bathy_photons_per_window = 0.25 * (x_resolution / icesat_2_sampling_rate); // photons
     double surface_n_stddev = 3.5;
     double bathy_n_stddev = 3.0;
+    double x_stride = 0.0; // meters, 0 means that windows do not overlap
 };
 
 std::ostream &operator<< (std::ostream &os, const params &params)
@@ -97,6 +100,7 @@ std::ostream &operator<< (std::ostream &os, const params &params)
     os << "min-bathy-photons-per-window: " << params.min_bathy_photons_per_window << " photons" << std::endl;
     os << "surface-n-stddev: " << params.surface_n_stddev << "m" << std::endl;
     os << "bathy-n-stddev: " << params.bathy_n_stddev << "m" << std::endl;
+    os << "x-stride: " << params.x_stride << "m" << std::endl;
 
     return os;
 }
@@ -263,24 +267,20 @@ std::vector<double> get_v_bin_elevations (const T &params)
     return e;
 }
 
-template<typename T,typename U,typename V,typename W,typename X>
-std::vector<size_t> get_surface_indexes (const T &p,
+// Get the vertical bin of the surface peak
+//
+// Returns h.size () if there is none.
+template<typename T,typename U,typename V,typename W>
+size_t get_surface_bin (const T &h,
     const U &se,
-    const V &v_bins,
-    const W &v_bin_elevations,
-    const X &params)
+    const V &v_bin_elevations,
+    const W &params)
 {
     using namespace oopp::utils;
     using namespace std;
 
     // Check invariants
-    assert (v_bins.size () == v_bin_elevations.size ());
-
-    // Get a histogram from the bin indexes
-    vector<size_t> h (v_bins.size ());
-
-    transform (v_bins.begin (), v_bins.end (), h.begin (),
-        [&](const auto &b) { return b.size (); });
+    assert (h.size () == v_bin_elevations.size ());
 
     // Convert the histogram to a probability mass function
     auto pmf = convert_to_pmf<double> (h);
@@ -311,62 +311,80 @@ std::vector<size_t> get_surface_indexes (const T &p,
         peak_v_bin_indexes.push_back (i);
     }
 
-    // Return value
-    vector<size_t> indexes;
-
     // If there are no peaks, there is nothing to do
     if (peak_v_bin_indexes.empty ())
-        return indexes;
-
-    // Set a sentinel
-    size_t surface_bin_index = v_bins.size ();
+        return h.size ();
 
     // If there is only one peak, it is the surface estimate
     if (peak_v_bin_indexes.size () == 1)
+        return peak_v_bin_indexes[0];
+
+    // Get the two highest peaks
+    //
+    // Height is determined by the number of photons in the bin
+    assert (peak_v_bin_indexes.size () >= 2);
+    nth_element (peak_v_bin_indexes.begin (),
+        peak_v_bin_indexes.begin () + 1,
+        peak_v_bin_indexes.end (),
+        [&](auto a, auto b) {
+            assert (a < h.size ());
+            assert (b < h.size ());
+            return h[a] > h[b]; });
+
+    // Get the sizes of the two bins
+    assert (peak_v_bin_indexes[0] < h.size ());
+    assert (peak_v_bin_indexes[1] < h.size ());
+    const size_t size0 = h[peak_v_bin_indexes[0]];
+    const size_t size1 = h[peak_v_bin_indexes[1]];
+
+    // If they are close in height...
+    if (std::min (size0, size1) > std::max (size0, size1) / 3)
     {
-        surface_bin_index = peak_v_bin_indexes[0];
-    }
-    else
-    {
-        // Get the two highest peaks
-        //
-        // Height is determined by the number of photons in the bin
-        assert (peak_v_bin_indexes.size () >= 2);
-        nth_element (peak_v_bin_indexes.begin (),
-            peak_v_bin_indexes.begin () + 1,
-            peak_v_bin_indexes.end (),
-            [&](auto a, auto b) {
-                assert (a < v_bins.size ());
-                assert (b < v_bins.size ());
-                return v_bins[a].size () > v_bins[b].size (); });
-
-        // Get the sizes of the two bins
-        assert (peak_v_bin_indexes[0] < v_bins.size ());
-        assert (peak_v_bin_indexes[1] < v_bins.size ());
-        const size_t size0 = v_bins[peak_v_bin_indexes[0]].size ();
-        const size_t size1 = v_bins[peak_v_bin_indexes[1]].size ();
-
-        // If they are close in height...
-        if (std::min (size0, size1) > std::max (size0, size1) / 3)
-        {
-            // ... use the one at the highest elevation
-            assert (peak_v_bin_indexes[0] < v_bin_elevations.size ());
-            assert (peak_v_bin_indexes[1] < v_bin_elevations.size ());
-            if (v_bin_elevations[peak_v_bin_indexes[0]] > v_bin_elevations[peak_v_bin_indexes[1]])
-                surface_bin_index = peak_v_bin_indexes[0];
-            else
-                surface_bin_index = peak_v_bin_indexes[1];
-        }
+        // ... use the one at the highest elevation
+        assert (peak_v_bin_indexes[0] < v_bin_elevations.size ());
+        assert (peak_v_bin_indexes[1] < v_bin_elevations.size ());
+        if (v_bin_elevations[peak_v_bin_indexes[0]] > v_bin_elevations[peak_v_bin_indexes[1]])
+            return peak_v_bin_indexes[0];
         else
-        {
-            // ... otherwise, use largest one
-            if (size0 > size1)
-                surface_bin_index = peak_v_bin_indexes[0];
-            else
-                surface_bin_index = peak_v_bin_indexes[1];
-        }
+            return peak_v_bin_indexes[1];
     }
 
+    // ... otherwise, use largest one
+    if (size0 > size1)
+        return peak_v_bin_indexes[0];
+    else
+        return peak_v_bin_indexes[1];
+}
+
+template<typename T,typename U,typename V,typename W,typename X>
+std::vector<size_t> get_surface_indexes (const T &p,
+    const U &se,
+    const V &v_bins,
+    const W &v_bin_elevations,
+    const X &params)
+{
+    using namespace oopp::utils;
+    using namespace std;
+
+    // Check invariants
+    assert (v_bins.size () == v_bin_elevations.size ());
+
+    // Get a histogram from the bin indexes
+    vector<size_t> h (v_bins.size ());
+
+    transform (v_bins.begin (), v_bins.end (), h.begin (),
+        [&](const auto &b) { return b.size (); });
+
+    // Return value
+    vector<size_t> indexes;
+
+    // Find the surface peak
+    const size_t surface_bin_index = get_surface_bin (h, se, v_bin_elevations, params);
+
+    // If there are no peaks, there is nothing to do
+    if (surface_bin_index == h.size ())
+        return indexes;
+
     // Get the local elevation of the surface
     assert (surface_bin_index < v_bin_elevations.size ());
     const double surface_elevation = v_bin_elevations[surface_bin_index];
@@ -375,7 +393,7 @@ std::vector<size_t> get_surface_indexes (const T &p,
     const double max_distance = 1.0; // meters
     vector<double> surface_elevations;
 
-    for (auto bin : v_bins) for (auto i : bin)
+    for (const auto &bin : v_bins) for (auto i : bin)
     {
         assert (i < p.size ());
         const double d = fabs (p[i].z - surface_elevation);
@@ -393,7 +411,7 @@ std::vector<size_t> get_surface_indexes (const T &p,
 
     // Get the indexes of all photons in this bin within N standard
     // deviations of the surface estimate
-    for (auto bin : v_bins) for (auto i : bin)
+    for (const auto &bin : v_bins) for (auto i : bin)
     {
         assert (i < p.size ());
         const double d = fabs (p[i].z - u);
@@ -408,10 +426,52 @@ std::vector<size_t> get_surface_indexes (const T &p,
     return indexes;
 }
 
+// Get the vertical bin of the bathy peak from a histogram of subsurface photons
+//
+// Returns h.size () if there is none.
+template<typename T,typename U>
+size_t get_bathy_bin (const T &h, const U &params)
+{
+    using namespace oopp::utils;
+    using namespace std;
+
+    // Convert the histogram to a probability mass function
+    auto pmf = convert_to_pmf<double> (h);
+
+    // Smooth it
+    pmf = gaussian_1D_filter (pmf, params.vertical_smoothing_sigma);
+
+    // Get peak bin indexes from the PMF
+    const auto peak_v_bin_indexes = find_peaks (pmf,
+        params.min_peak_prominence,
+        params.min_peak_distance);
+
+    // We need at least one peak
+    if (peak_v_bin_indexes.empty ())
+        return h.size ();
+
+    // Use the highest peak
+    //
+    // Peak heights are determined by the number of photons in each bin
+    return *max_element (peak_v_bin_indexes.begin (),
+        peak_v_bin_indexes.end (),
+        [&](auto a, auto b) {
+            assert (a < h.size ());
+            assert (b < h.size ());
+            return h[a] < h[b]; });
+}
+
+// Photons at or above this elevation are too close to the surface to be bathy
+template<typename T,typename U>
+double get_bathy_z_max (const T &se, const U &params)
+{
+    return se.mean - params.bathy_n_stddev * sqrt (se.variance);
+}
+
 template<typename T,typename U,typename V,typename W,typename X>
 std::vector<size_t> get_bathy_indexes (const T &p,
     const U &se,
-    V v_bins,
+    const V &all_v_bins,
     const W &v_bin_elevations,
     const X &params)
 {
@@ -419,36 +479,33 @@ std::vector<size_t> get_bathy_indexes (const T &p,
     using namespace std;
 
     // Check invariants
-    assert (v_bins.size () == v_bin_elevations.size ());
+    assert (all_v_bins.size () == v_bin_elevations.size ());
 
     // Remove indexes of photons below the surface
-    V tmp_v_bins (v_bins.size ());
+    vector<vector<size_t>> v_bins (all_v_bins.size ());
 
     size_t total_subsurface_photons = 0;
 
-    for (size_t i = 0; i < v_bins.size (); ++i)
+    // If it's too close to the surface, skip it
+    const double z_max = get_bathy_z_max (se, params);
+
+    for (size_t i = 0; i < all_v_bins.size (); ++i)
     {
-        for (size_t j = 0; j < v_bins[i].size (); ++j)
+        for (auto index : all_v_bins[i])
         {
-            const size_t index = v_bins[i][j];
             assert (index < p.size ());
 
-            // If it's too close to the surface, skip it
-            const double z_min = se.mean - params.bathy_n_stddev * sqrt (se.variance);
-            if (p[index].z >= z_min)
+            if (p[index].z >= z_max)
                 continue;
 
             // Save the photon index
-            tmp_v_bins[i].push_back (index);
+            v_bins[i].push_back (index);
 
             // Count it
             ++total_subsurface_photons;
         }
     }
 
-    // Save new one
-    v_bins = tmp_v_bins;
-
     // Return value
     vector<size_t> indexes;
 
@@ -462,31 +519,13 @@ std::vector<size_t> get_bathy_indexes (const T &p,
     transform (v_bins.begin (), v_bins.end (), h.begin (),
         [&](const auto &b) { return b.size (); });
 
-    // Convert the histogram to a probability mass function
-    auto pmf = convert_to_pmf<double> (h);
-
-    // Smooth it
-    pmf = gaussian_1D_filter (pmf, params.vertical_smoothing_sigma);
-
-    // Get peak bin indexes from the PMF
-    const auto peak_v_bin_indexes = find_peaks (pmf,
-        params.min_peak_prominence,
-        params.min_peak_distance);
+    // Find the bathy peak
+    const size_t bathy_bin_index = get_bathy_bin (h, params);
 
     // We need at least one peak
-    if (peak_v_bin_indexes.empty ())
+    if (bathy_bin_index == h.size ())
         return indexes;
 
-    // Use the highest peak
-    //
-    // Peak heights are determined by the number of photons in each bin
-    const size_t bathy_bin_index = *max_element (peak_v_bin_indexes.begin (),
-        peak_v_bin_indexes.end (),
-        [&](auto a, auto b) {
-            assert (a < v_bins.size ());
-            assert (b < v_bins.size ());
-            return v_bins[a].size () < v_bins[b].size (); });
-
     // Get the elevation of the bathy estimate
     assert (bathy_bin_index < v_bins.size ());
     assert (!v_bins[bathy_bin_index].empty ());
@@ -497,7 +536,7 @@ std::vector<size_t> get_bathy_indexes (const T &p,
     const double max_distance = 1.0; // meters
     vector<double> bathy_photons;
 
-    for (auto bin : v_bins) for (auto i : bin)
+    for (const auto &bin : v_bins) for (auto i : bin)
     {
         assert (i < p.size ());
         const double d = fabs (p[i].z - bathy_elevation);
@@ -515,7 +554,7 @@ std::vector<size_t> get_bathy_indexes (const T &p,
 
     // Get the indexes of all photons in this bin within some standard
     // deviations of the bathy estimate
-    for (auto bin : v_bins) for (auto i : bin)
+    for (const auto &bin : v_bins) for (auto i : bin)
     {
         assert (i < p.size ());
         const double d = fabs (p[i].z - u);
@@ -601,6 +640,27 @@ std::vector<double> get_smooth_estimates (const T &p, const U &h_bins, const V &
     const size_t total = (x_max - x_min) / resolution + 1;
     vector<double> z (total, NAN);
 
+    // Get the first interval of each window
+    vector<size_t> first (h_bins.size (), total);
+#pragma omp parallel for
+    for (size_t i = 0; i < h_bins.size (); ++i)
+    {
+        for (auto j : h_bins[i])
+        {
+            assert (j < p.size ());
+            assert (p[j].x >= x_min);
+            first[i] = std::min (first[i], static_cast<size_t> ((p[j].x - x_min) / resolution));
+        }
+    }
+
+    // Windows are in along-track order, but they can share an interval
+    // when they are not a multiple of 'resolution' long. A window can
+    // only share its last interval, with the next windows, and that
+    // interval belongs to the last window that has photons in it.
+    vector<size_t> next_first (h_bins.size (), total);
+    for (size_t i = h_bins.size (); i > 1; --i)
+        next_first[i - 2] = std::min (next_first[i - 1], first[i - 1]);
+
 #pragma omp parallel for
     for (size_t i = 0; i < h_bins.size (); ++i)
     {
@@ -610,6 +670,11 @@ std::vector<double> get_smooth_estimates (const T &p, const U &h_bins, const V &
             assert (p[j].x >= x_min);
             const size_t index = (p[j].x - x_min) / resolution;
 
+            // Leave it to a later window
+            assert (index <= next_first[i]);
+            if (index == next_first[i])
+                continue;
+
             // The photon gets the elevation associated with the window
             assert (!std::isnan (op (e[i])));
             assert (index < z.size ());
@@ -670,22 +735,14 @@ std::vector<double> get_smooth_estimates (const T &p, const U &h_bins, const V &
     return s;
 }
 
-template<typename T,typename U>
-T classify (T p, const U &params)
+// Get surface and bathy estimates for each horizontal window
+template<typename T,typename U,typename V,typename W>
+std::vector<estimates> get_window_estimates (const T &p,
+    const U &se,
+    const V &h_bins,
+    const W &params)
 {
     using namespace std;
-    using namespace oopp::utils;
-
-    // Assume that there is a single sea surface in the track. If
-    // there is a case that a land mass separates two water bodies,
-    // and the surface of the water bodies is significantly different,
-    // then this will likely cause this function to fail. However, for
-    // the on-demand product, when this occurs, you should change your
-    // AOIs so that the two water bodies are separated.
-    const auto se = get_surface_estimate (p, params);
-
-    // Get indexes of photons in each along-track bin
-    const auto h_bins = get_h_bins (p, params);
 
     // Get each vertical bin's elevation
     const auto v_bin_elevations = get_v_bin_elevations (params);
@@ -701,6 +758,8 @@ T classify (T p, const U &params)
         if (h_bins[i].empty ())
             continue;
 
+        OOPP_TRACE_SPAN ("window");
+
         // Construct vertical distribution at each horizontal bin
         const auto v_bins = get_v_bins (p, h_bins[i], params);
 
@@ -708,15 +767,388 @@ T classify (T p, const U &params)
         e[i] = get_estimates (p, se, v_bins, v_bin_elevations, params);
     }
 
+    return e;
+}
+
+// Windows overlap when they advance by less than their length
+template<typename T>
+bool has_overlapping_windows (const T &params)
+{
+    return params.x_stride > 0.0 && params.x_stride < params.x_resolution;
+}
+
+// The number, mean and variance of a set of photon elevations
+struct moments
+{
+    size_t n = 0;
+    double mean = 0.0;
+    double variance = 0.0;
+};
+
+// A vertical histogram of the photons in a sliding window
+//
+// Photons enter and leave the window in along-track order, so each bin
+// is a vector whose front moves forward. Each bin also keeps the sums
+// of its photons' offsets from the bin's center, so the moments of the
+// photons in a range of elevations only visit the photons in the bins
+// on the edges of the range.
+class sliding_histogram
+{
+    public:
+    explicit sliding_histogram (const std::vector<double> &v_bin_elevations)
+        : centers (v_bin_elevations)
+        , half_width (v_bin_elevations.size () > 1 ? (v_bin_elevations[1] - v_bin_elevations[0]) / 2.0 : 0.0)
+        , bins (v_bin_elevations.size ())
+        , front (v_bin_elevations.size ())
+        , h (v_bin_elevations.size ())
+        , s1 (v_bin_elevations.size ())
+        , s2 (v_bin_elevations.size ())
+    {
+    }
+
+    template<typename T>
+    void push (const T &p, const size_t bin, const size_t index)
+    {
+        assert (bin < bins.size ());
+        bins[bin].push_back (index);
+        ++h[bin];
+        ++n;
+        const double d = p[index].z - centers[bin];
+        s1[bin] += d;
+        s2[bin] += d * d;
+    }
+
+    template<typename T>
+    void pop (const T &p, const size_t bin, const size_t index)
+    {
+        assert (bin < bins.size ());
+        assert (h[bin] != 0);
+        assert (bins[bin][front[bin]] == index);
+        ++front[bin];
+        --h[bin];
+        --n;
+
+        // An empty bin starts over, which also drops the rounding
+        // error in its sums
+        if (h[bin] == 0)
+        {
+            bins[bin].clear ();
+            front[bin] = 0;
+            s1[bin] = 0.0;
+            s2[bin] = 0.0;
+            return;
+        }
+
+        const double d = p[index].z - centers[bin];
+        s1[bin] -= d;
+        s2[bin] -= d * d;
+
+        // Reclaim the space of photons that left
+        if (2 * front[bin] > bins[bin].size ())
+        {
+            bins[bin].erase (bins[bin].begin (), bins[bin].begin () + front[bin]);
+            front[bin] = 0;
+        }
+    }
+
+    // Number of photons in each bin
+    const std::vector<size_t> &counts () const { return h; }
+
+    // Total number of photons
+    size_t size () const { return n; }
+
+    /// @brief Get the moments of the photons whose elevations are less than 'distance' from 'z'
+    template<typename T>
+    moments get_moments (const T &p, const double z, const double distance) const
+    {
+        // A photon can be rounded into a neighboring bin
+        const double margin = 1e-6; // meters
+
+        // Sums of offsets from 'z'
+        size_t total = 0;
+        double sum = 0.0;
+        double sum2 = 0.0;
+
+        // Only visit the bins that can overlap the range
+        if (bins.empty () || !(distance > 0.0))
+            return moments ();
+        const double z0 = centers[0] - half_width;
+        const double width = 2.0 * half_width;
+        const double first = std::max (0.0, floor ((z - distance - z0) / width) - 1.0);
+        const double last = std::clamp (floor ((z + distance - z0) / width) + 2.0, 0.0, static_cast<double> (bins.size ()));
+
+        for (size_t b = first; b < last; ++b)
+        {
+            if (h[b] == 0)
+                continue;
+
+            const double lo = centers[b] - half_width - margin;
+            const double hi = centers[b] + half_width + margin;
+
+            // Entirely outside
+            if (hi <= z - distance || lo >= z + distance)
+                continue;
+
+            // Entirely inside
+            if (fabs (lo - z) < distance && fabs (hi - z) < distance)
+            {
+                const double c = centers[b] - z;
+                total += h[b];
+                sum += h[b] * c + s1[b];
+                sum2 += h[b] * c * c + 2.0 * c * s1[b] + s2[b];
+                continue;
+            }
+
+            // On an edge
+            for (size_t i = front[b]; i < bins[b].size (); ++i)
+            {
+                assert (bins[b][i] < p.size ());
+                const double d = p[bins[b][i]].z - z;
+                if (fabs (d) < distance)
+                {
+                    ++total;
+                    sum += d;
+                    sum2 += d * d;
+                }
+            }
+        }
+
+        moments m;
+        if (total == 0)
+            return m;
+
+        m.n = total;
+        m.mean = z + sum / total;
+        m.variance = std::max (0.0, sum2 / total - (sum / total) * (sum / total));
+        return m;
+    }
+
+    private:
+    const std::vector<double> &centers;
+    const double half_width;
+    std::vector<std::vector<size_t>> bins;
+    std::vector<size_t> front;
+    std::vector<size_t> h;
+    std::vector<double> s1;
+    std::vector<double> s2;
+    size_t n = 0;
+};
+
+// The photons that get_surface_indexes() and get_bathy_indexes() select
+struct selection
+{
+    double center = 0.0; // Photons closer than 'distance' to 'center' are selected
+    double distance = 0.0;
+    size_t n = 0; // Number of photons in the window that are selected
+    double mean = 0.0; // Their mean elevation
+
+    template<typename T>
+    bool contains (const T &photon) const { return fabs (photon.z - center) < distance; }
+};
+
+// Select the photons in a sliding window that are near a peak
+//
+// Returns an empty selection if there are too few.
+template<typename T>
+selection select_from_peak (const T &p,
+    const sliding_histogram &h,
+    const double peak_elevation,
+    const double n_stddev,
+    const size_t min_photons)
+{
+    // Get the shape of the photon distribution near the peak
+    const double max_distance = 1.0; // meters
+    const auto near = h.get_moments (p, peak_elevation, max_distance);
+    if (near.n == 0)
+        return selection ();
+
+    // Get the photons within N standard deviations of it
+    selection s;
+    s.center = near.mean;
+    s.distance = sqrt (near.variance) * n_stddev;
+    const auto selected = h.get_moments (p, s.center, s.distance);
+
+    // Check to make sure we have enough
+    if (selected.n == 0 || selected.n < min_photons)
+        return selection ();
+
+    s.n = selected.n;
+    s.mean = selected.mean;
+    return s;
+}
+
+// Get surface and bathy estimates using overlapping windows
+//
+// Each cell is 'x_stride' meters long, and the photons in a cell are
+// classified using an 'x_resolution' meter window centered on the
+// cell. As the window slides along the track, the photons that enter
+// it are added to its vertical histograms and the ones that leave it
+// are removed. Choosing the peaks visits the bins, and selecting
+// photons visits the photons in the cell and in the bins on the edges
+// of the selected ranges, so the work per cell does not grow with the
+// number of photons in the window.
+template<typename T,typename U,typename V,typename W>
+std::vector<estimates> get_sliding_estimates (const T &p,
+    const U &se,
+    const V &cells,
+    const W &params)
+{
+    using namespace std;
+
+    // Check invariants
+    assert (has_overlapping_windows (params));
+
+    vector<estimates> e (cells.size ());
+
+    if (p.empty ())
+        return e;
+
+    // Get the bounds
+    const double x_min = min_element (p.begin (), p.end (),
+            [](const auto &a, const auto &b) { return a.x < b.x; })->x;
+
+    // Get in-range photon indexes in along-track order
+    vector<size_t> order;
+    order.reserve (p.size ());
+    for (size_t i = 0; i < p.size (); ++i)
+        if (p[i].z <= params.z_max && p[i].z >= params.z_min)
+            order.push_back (i);
+    stable_sort (order.begin (), order.end (),
+        [&](const auto a, const auto b) { return p[a].x < p[b].x; });
+
+    // Get each vertical bin's elevation
+    const auto v_bin_elevations = get_v_bin_elevations (params);
+
+    // Photons at or above this elevation can't be bathy
+    const double bathy_z_max = get_bathy_z_max (se, params);
+
+    // Get the extent of the window centered on a cell
+    const auto window_begin = [&](const size_t c)
+        { return x_min + (c + 0.5) * params.x_stride - params.x_resolution / 2.0; };
+    const auto window_end = [&](const size_t c)
+        { return x_min + (c + 0.5) * params.x_stride + params.x_resolution / 2.0; };
+
+    // Get the index of the first photon at or after 'x'
+    const auto lower_bound = [&](const double x)
+        { return std::lower_bound (order.begin (), order.end (), x,
+            [&](const auto i, const double y) { return p[i].x < y; }) - order.begin (); };
+
+    const auto get_bin = [&](const size_t i)
+        { return static_cast<size_t> ((p[i].z - params.z_min) / params.z_resolution); };
+
+    // Each chunk of cells is processed in order, so that the window
+    // can slide. Chunks are long enough that initializing their first
+    // window is a small part of the work.
+    const size_t cells_per_chunk = std::max (1.0, 16.0 * params.x_resolution / params.x_stride);
+    const size_t total_chunks = (cells.size () + cells_per_chunk - 1) / cells_per_chunk;
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t chunk = 0; chunk < total_chunks; ++chunk)
+    {
+        OOPP_TRACE_SPAN ("sliding_chunk");
+
+        const size_t c0 = chunk * cells_per_chunk;
+        const size_t c1 = std::min (c0 + cells_per_chunk, cells.size ());
+
+        // All photons in the window, and those that can be bathy
+        sliding_histogram all (v_bin_elevations);
+        sliding_histogram subsurface (v_bin_elevations);
+
+        // The window contains order[lo] ... order[hi - 1]
+        size_t lo = lower_bound (window_begin (c0));
+        size_t hi = lo;
+
+        for (size_t c = c0; c < c1; ++c)
+        {
+            // Add photons that entered the window
+            const double x1 = window_end (c);
+            for ( ; hi < order.size () && p[order[hi]].x < x1; ++hi)
+            {
+                const size_t i = order[hi];
+                all.push (p, get_bin (i), i);
+                if (p[i].z < bathy_z_max)
+                    subsurface.push (p, get_bin (i), i);
+            }
+
+            // Remove photons that left the window
+            const double x0 = window_begin (c);
+            for ( ; lo < hi && p[order[lo]].x < x0; ++lo)
+            {
+                const size_t i = order[lo];
+                all.pop (p, get_bin (i), i);
+                if (p[i].z < bathy_z_max)
+                    subsurface.pop (p, get_bin (i), i);
+            }
+
+            // If there are no photons in the cell, there is nothing to do
+            if (cells[c].empty ())
+                continue;
+
+            // Get the surface from the whole window
+            const size_t surface_bin = get_surface_bin (all.counts (), se, v_bin_elevations, params);
+            if (surface_bin == v_bin_elevations.size ())
+                continue;
+
+            const auto s = select_from_peak (p, all, v_bin_elevations[surface_bin],
+                params.surface_n_stddev, params.min_surface_photons_per_window);
+
+            // If there is no surface, there is no bathy
+            if (s.n == 0)
+                continue;
+
+            // Only the photons in the cell are classified
+            e[c].surface_elevation = s.mean;
+            for (auto i : cells[c])
+                if (s.contains (p[i]))
+                    e[c].surface_indexes.push_back (i);
+
+            // Get the bathy from the whole window
+            if (subsurface.size () == 0)
+                continue;
+
+            const size_t bathy_bin = get_bathy_bin (subsurface.counts (), params);
+            if (bathy_bin == v_bin_elevations.size ())
+                continue;
+
+            const auto b = select_from_peak (p, subsurface, v_bin_elevations[bathy_bin],
+                params.bathy_n_stddev, params.min_bathy_photons_per_window);
+            if (b.n == 0)
+                continue;
+
+            e[c].bathy_elevation = b.mean;
+            for (auto i : cells[c])
+                if (p[i].z < bathy_z_max && b.contains (p[i]))
+                    e[c].bathy_indexes.push_back (i);
+        }
+    }
+
+    return e;
+}
+
+// Smooth the window estimates and assign them to the photons
+template<typename T,typename U,typename V,typename P>
+T assign_estimates (T p, const U &h_bins, const std::vector<estimates> &e, const V &params, P &prof)
+{
+    using namespace std;
+
+    // Check invariants
+    assert (h_bins.size () == e.size ());
+
     // Smooth the surface and bathy elevation estimates
-    const auto ss = get_smooth_estimates (p, h_bins, e, params.surface_smoothing_sigma,
-        [](const estimates &a) { return a.surface_elevation; });
-    const auto sb = get_smooth_estimates (p, h_bins, e, params.bathy_smoothing_sigma,
-        [](const estimates &a) { return a.bathy_elevation; });
+    const auto ss = prof.run ("surface_smoothing", p.size (), [&] {
+        return get_smooth_estimates (p, h_bins, e, params.surface_smoothing_sigma,
+            [](const estimates &a) { return a.surface_elevation; }); });
+    const auto sb = prof.run ("bathy_smoothing", p.size (), [&] {
+        return get_smooth_estimates (p, h_bins, e, params.bathy_smoothing_sigma,
+            [](const estimates &a) { return a.bathy_elevation; }); });
 
     assert (ss.size () == p.size ());
     assert (sb.size () == p.size ());
 
+    // The rest of the function is the assignment stage
+    [[maybe_unused]] const auto s = prof.start ("assignment", p.size ());
+    OOPP_TRACE_SPAN ("assignment");
+
     // Zero out predictions
 #pragma omp parallel for
     for (size_t i = 0; i < p.size (); ++i)
@@ -756,4 +1188,154 @@ T classify (T p, const U &params)
     return p;
 }
 
+template<typename T,typename U,typename V>
+T assign_estimates (T p, const U &h_bins, const std::vector<estimates> &e, const V &params)
+{
+    profile::null_profiler prof;
+    return assign_estimates (std::move (p), h_bins, e, params, prof);
+}
+
+/// @brief Classify a track
+/// @param p Photons
+/// @param params Parameters
+/// @param prof Records the time and allocations of each stage
+template<typename T,typename U,typename P>
+T classify (T p, const U &params, P &prof)
+{
+    using namespace std;
+
+    // Assume that there is a single sea surface in the track. If
+    // there is a case that a land mass separates two water bodies,
+    // and the surface of the water bodies is significantly different,
+    // then this will likely cause this function to fail. However, for
+    // the on-demand product, when this occurs, you should change your
+    // AOIs so that the two water bodies are separated.
+    const auto se = prof.run ("surface_estimate", p.size (), [&] {
+        return get_surface_estimate (p, params); });
+
+    if (has_overlapping_windows (params))
+    {
+        // Get indexes of photons in each along-track cell
+        auto cell_params (params);
+        cell_params.x_resolution = params.x_stride;
+        const auto cells = prof.run ("h_binning", p.size (), [&] {
+            return get_h_bins (p, cell_params); });
+
+        // Get surface and bathy estimates for each cell
+        const auto e = prof.run ("window_loop", p.size (), [&] {
+            return get_sliding_estimates (p, se, cells, params); });
+
+        // Smooth the estimates and assign predictions
+        return assign_estimates (move (p), cells, e, params, prof);
+    }
+
+    // Get indexes of photons in each along-track bin
+    const auto h_bins = prof.run ("h_binning", p.size (), [&] {
+        return get_h_bins (p, params); });
+
+    // Get surface and bathy estimates for each horizontal window
+    const auto e = prof.run ("window_loop", p.size (), [&] {
+        return get_window_estimates (p, se, h_bins, params); });
+
+    // Smooth the estimates and assign predictions
+    return assign_estimates (move (p), h_bins, e, params, prof);
+}
+
+template<typename T,typename U>
+T classify (T p, const U &params)
+{
+    profile::null_profiler prof;
+    return classify (std::move (p), params, prof);
+}
+
+/// @brief Classify several tracks at once
+/// @param tracks Photons for each track
+/// @param params Parameters used for all tracks
+/// @return Classified photons for each track
+///
+/// All tracks are processed in a single parallel region, and the
+/// windows of all tracks are scheduled jointly, so that short tracks
+/// do not leave threads idle.
+template<typename T,typename U>
+std::vector<T> classify_batch (std::vector<T> tracks, const U &params)
+{
+    using namespace std;
+
+    // Overlapping windows are processed one track at a time
+    if (has_overlapping_windows (params))
+    {
+        for (auto &p : tracks)
+            if (!p.empty ())
+                p = classify (move (p), params);
+        return tracks;
+    }
+
+    const size_t n = tracks.size ();
+    vector<surface_estimate> se (n);
+    vector<vector<vector<size_t>>> h_bins (n);
+    vector<vector<estimates>> e (n);
+
+    // Windows to process, (track, window)
+    vector<pair<size_t,size_t>> windows;
+
+    // Get each vertical bin's elevation
+    const auto v_bin_elevations = get_v_bin_elevations (params);
+
+#pragma omp parallel
+    {
+        // Get per-track surface estimates and horizontal bins
+#pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (tracks[i].empty ())
+                continue;
+
+            OOPP_TRACE_SPAN ("h_binning");
+
+            se[i] = get_surface_estimate (tracks[i], params);
+            h_bins[i] = get_h_bins (tracks[i], params);
+            e[i].resize (h_bins[i].size ());
+        }
+
+        // Gather the windows of all tracks
+#pragma omp single
+        {
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = 0; j < h_bins[i].size (); ++j)
+                    if (!h_bins[i][j].empty ())
+                        windows.push_back ({ i, j });
+        }
+
+        // Get estimates for each horizontal window
+#pragma omp for schedule(dynamic, 16)
+        for (size_t k = 0; k < windows.size (); ++k)
+        {
+            const auto i = windows[k].first;
+            const auto j = windows[k].second;
+
+            OOPP_TRACE_SPAN ("window");
+
+            // Construct vertical distribution at each horizontal bin
+            const auto v_bins = get_v_bins (tracks[i], h_bins[i][j], params);
+
+            // Get surface and bathy estimates
+            e[i][j] = get_estimates (tracks[i], se[i], v_bins, v_bin_elevations, params);
+        }
+
+        // Smooth the estimates and assign predictions
+#pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (tracks[i].empty ())
+                continue;
+
+            OOPP_TRACE_SPAN ("assign_estimates");
+
+            tracks[i] = assign_estimates (move (tracks[i]), h_bins[i], e[i], params);
+        }
+    }
+
+    return tracks;
+}
+
 } // namespace oopp
@@ -0,0 +1,334 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/memory.h"
+#include "oopp/timer.h"
+#include "oopp/trace.h"
+
+namespace oopp
+{
+
+namespace profile
+{
+
+namespace detail
+{
+
+// Allocation counters, updated by the operator new and delete hooks
+inline std::atomic<bool> counting { false };
+inline std::atomic<uint64_t> allocations { 0 };
+inline std::atomic<uint64_t> bytes { 0 };
+inline std::atomic<uint64_t> live { 0 };
+inline std::atomic<uint64_t> peak { 0 };
+
+// Raise the high-water mark of live bytes
+inline void update_peak (const uint64_t n)
+{
+    uint64_t p = peak.load (std::memory_order_relaxed);
+    while (p < n && !peak.compare_exchange_weak (p, n, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Each allocation made by the operator new hook is prefixed with its
+// size, so that the delete hook can update the live bytes. The header
+// keeps the alignment of 'malloc'.
+struct alignas (std::max_align_t) header
+{
+    size_t size;
+    bool counted;
+};
+
+// Turns counting off for its lifetime
+struct pause
+{
+    pause () : was_counting (counting.exchange (false)) { }
+    ~pause () { counting = was_counting; }
+    bool was_counting;
+};
+
+// Set the high-water mark, and return the old one
+inline uint64_t exchange_peak (const uint64_t n)
+{
+    return peak.exchange (n, std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+// Allocation counts at a point in time
+struct allocation_counts
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t live = 0;
+};
+
+// Whether the operator new hook was compiled into this program
+bool counts_allocations ()
+{
+#ifdef OOPP_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/// @brief Turn allocation counting on or off
+///
+/// This only has an effect in programs that define
+/// OOPP_COUNT_ALLOCATIONS before including this file. Memory that is
+/// allocated while counting is off is not included in the live bytes,
+/// even when it is freed while counting is on.
+void count_allocations (const bool enable)
+{
+    detail::counting = enable;
+}
+
+allocation_counts get_allocation_counts ()
+{
+    return allocation_counts {
+        detail::allocations.load (std::memory_order_relaxed),
+        detail::bytes.load (std::memory_order_relaxed),
+        detail::live.load (std::memory_order_relaxed) };
+}
+
+// Wall time, photons and memory use of one stage
+struct stage
+{
+    std::string name;
+    double seconds;
+    size_t photons;
+    uint64_t allocations; // Number of allocations
+    uint64_t bytes; // Bytes allocated
+    uint64_t peak_heap_bytes; // High-water mark of live counted bytes
+    uint64_t rss_bytes; // Resident set size at the end of the stage
+    uint64_t peak_rss_bytes; // High-water mark of the resident set size
+};
+
+// Records stages in the order in which they finish
+//
+// Stages are timed from the calling thread, so they should be started
+// outside of parallel regions. Memory is only sampled while allocations
+// are counted. Stages may nest, in which case the peaks of the outer
+// stage include those of the inner ones.
+class profiler
+{
+    public:
+    // Records a stage when it goes out of scope
+    class scope
+    {
+        public:
+        scope (profiler &prof, const char *name, const size_t photons)
+            : p (prof)
+            , s { name, 0.0, photons, 0, 0, 0, 0, 0 }
+            , sampling (detail::counting.load (std::memory_order_relaxed))
+            , a (get_allocation_counts ())
+        {
+            if (!sampling)
+                return;
+
+            // Reading /proc allocates, which shouldn't count
+            [[maybe_unused]] const detail::pause pause;
+
+            // Save the peaks of any enclosing stage, and start new ones
+            outer_heap_peak = detail::exchange_peak (a.live);
+            outer_rss_peak = std::exchange (p.rss_peak, 0);
+            if (!memory::reset_peak_rss ())
+                p.rss_peak = memory::get_rss ();
+        }
+        ~scope ()
+        {
+            t.stop ();
+            const auto b = get_allocation_counts ();
+            s.seconds = t.elapsed_ns () / 1'000'000'000;
+            s.allocations = b.allocations - a.allocations;
+            s.bytes = b.bytes - a.bytes;
+
+            if (sampling)
+            {
+                [[maybe_unused]] const detail::pause pause;
+                s.rss_bytes = memory::get_rss ();
+                s.peak_heap_bytes = detail::exchange_peak (0);
+                s.peak_rss_bytes = std::max ({ memory::get_peak_rss (), p.rss_peak, s.rss_bytes });
+
+                // Carry the peaks over to any enclosing stage
+                detail::update_peak (std::max (outer_heap_peak, s.peak_heap_bytes));
+                p.rss_peak = std::max (outer_rss_peak, s.peak_rss_bytes);
+            }
+
+            p.stages.push_back (s);
+        }
+        scope (const scope &) = delete;
+        scope &operator= (const scope &) = delete;
+
+        // For stages that don't know their size until they finish
+        void set_photons (const size_t photons) { s.photons = photons; }
+
+        private:
+        profiler &p;
+        stage s;
+        bool sampling;
+        allocation_counts a;
+        uint64_t outer_heap_peak = 0;
+        uint64_t outer_rss_peak = 0;
+        timer::timer t;
+    };
+
+    [[nodiscard]] scope start (const char *name, const size_t photons)
+    {
+        return scope (*this, name, photons);
+    }
+
+    // Run a function as a stage and return its result
+    template<typename F>
+    auto run (const char *name, const size_t photons, F f)
+    {
+        const scope s (*this, name, photons);
+        OOPP_TRACE_SPAN (name);
+        return f ();
+    }
+
+    const std::vector<stage> &get_stages () const { return stages; }
+
+    private:
+    std::vector<stage> stages;
+    // Peak resident set size of the stages that ended inside the
+    // current one
+    uint64_t rss_peak = 0;
+};
+
+// The default profiler, which does nothing
+struct null_profiler
+{
+    struct scope
+    {
+        void set_photons (const size_t) { }
+    };
+
+    scope start (const char *, const size_t)
+    {
+        return scope ();
+    }
+
+    template<typename F>
+    auto run ([[maybe_unused]] const char *name, const size_t, F f)
+    {
+        OOPP_TRACE_SPAN (name);
+        return f ();
+    }
+};
+
+/// @brief Write the stages as JSON
+std::ostream &write_json (std::ostream &os, const profiler &prof)
+{
+    using namespace std;
+
+    os << "{" << endl;
+    os << "  \"allocations_counted\": " << boolalpha << counts_allocations () << "," << endl;
+    os << "  \"stages\": [";
+    const auto &stages = prof.get_stages ();
+    for (size_t i = 0; i < stages.size (); ++i)
+    {
+        const auto &s = stages[i];
+        os << (i == 0 ? "" : ",") << endl;
+        os << "    {"
+            << "\"name\": \"" << s.name << "\", "
+            << "\"seconds\": " << fixed << setprecision (6) << s.seconds << ", "
+            << "\"photons\": " << s.photons << ", "
+            << "\"allocations\": " << s.allocations << ", "
+            << "\"bytes_allocated\": " << s.bytes << ", "
+            << "\"peak_heap_bytes\": " << s.peak_heap_bytes << ", "
+            << "\"rss_bytes\": " << s.rss_bytes << ", "
+            << "\"peak_rss_bytes\": " << s.peak_rss_bytes
+            << "}";
+    }
+    os << endl << "  ]" << endl;
+    os << "}" << endl;
+    return os;
+}
+
+/// @brief Write the stages as a table
+///
+/// Memory is shown in megabytes
+std::ostream &write_table (std::ostream &os, const profiler &prof)
+{
+    using namespace std;
+
+    const double MB = 1 << 20;
+    os << "stage"
+        << "\t" << "seconds"
+        << "\t" << "photons"
+        << "\t" << "allocations"
+        << "\t" << "MB_allocated"
+        << "\t" << "peak_heap_MB"
+        << "\t" << "rss_MB"
+        << "\t" << "peak_rss_MB"
+        << endl;
+    for (const auto &s : prof.get_stages ())
+        os << s.name
+            << "\t" << fixed << setprecision (6) << s.seconds
+            << "\t" << s.photons
+            << "\t" << s.allocations
+            << "\t" << setprecision (1) << s.bytes / MB
+            << "\t" << s.peak_heap_bytes / MB
+            << "\t" << s.rss_bytes / MB
+            << "\t" << s.peak_rss_bytes / MB
+            << endl;
+    return os;
+}
+
+} // namespace profile
+
+} // namespace oopp
+
+#ifdef OOPP_COUNT_ALLOCATIONS
+
+// GCC sees through the replacement operators once they are inlined,
+// and warns about the header and about 'free' on memory from 'new'
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#pragma GCC diagnostic ignored "-Warray-bounds"
+
+// Count allocations while counting is turned on
+void *operator new (const size_t n)
+{
+    using namespace oopp::profile::detail;
+
+    auto h = static_cast<header *> (std::malloc (sizeof (header) + n));
+    if (h == nullptr)
+        throw std::bad_alloc ();
+
+    h->size = n;
+    h->counted = counting.load (std::memory_order_relaxed);
+
+    if (h->counted)
+    {
+        allocations.fetch_add (1, std::memory_order_relaxed);
+        bytes.fetch_add (n, std::memory_order_relaxed);
+        update_peak (live.fetch_add (n, std::memory_order_relaxed) + n);
+    }
+
+    return h + 1;
+}
+
+void operator delete (void *p) noexcept
+{
+    using namespace oopp::profile::detail;
+
+    if (p == nullptr)
+        return;
+
+    auto h = static_cast<header *> (p) - 1;
+    if (h->counted)
+        live.fetch_sub (h->size, std::memory_order_relaxed);
+    std::free (h);
+}
+
+void operator delete (void *p, size_t) noexcept
+{
+    ::operator delete (p);
+}
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+
+namespace oopp
+{
+
+namespace residuals
+{
+
+// Summary statistics of elevation residuals
+//
+// Percentiles come from a fixed-width histogram, so they are accurate
+// to within one bin width, and two sets of statistics can be merged
+// exactly by adding their counts.
+class stats
+{
+    public:
+    /// @brief Constructor
+    /// @param bin_width Histogram bin width in meters
+    /// @param max_residual Residuals larger than this are clamped to the outermost bins
+    explicit stats (const double bin_width = 0.01, const double max_residual = 20.0)
+        : width (bin_width)
+        , max_abs (max_residual)
+        , n (0)
+        , sum (0.0)
+        , sum_sq (0.0)
+        , sum_abs (0.0)
+        , bins (2 * static_cast<size_t> (std::ceil (max_residual / bin_width)) + 1)
+    {
+        assert (bin_width > 0.0);
+    }
+
+    // Add a residual
+    void update (const double r)
+    {
+        ++n;
+        sum += r;
+        sum_sq += r * r;
+        sum_abs += std::fabs (r);
+        ++bins[get_bin (r)];
+    }
+
+    // Add statistics to these ones
+    void add (const stats &s)
+    {
+        assert (s.width == width);
+        assert (s.bins.size () == bins.size ());
+        n += s.n;
+        sum += s.sum;
+        sum_sq += s.sum_sq;
+        sum_abs += s.sum_abs;
+        for (size_t i = 0; i < bins.size (); ++i)
+            bins[i] += s.bins[i];
+    }
+
+    double bin_width () const { return width; }
+    double max_residual () const { return max_abs; }
+    uint64_t count () const { return n; }
+
+    // Mean residual
+    double bias () const { return sum / n; }
+
+    // Root mean squared residual
+    double RMSE () const { return std::sqrt (sum_sq / n); }
+
+    // Mean absolute residual
+    double MAE () const { return sum_abs / n; }
+
+    /// @brief Get a percentile of the residuals
+    /// @param p Percentile, between 0.0 and 1.0
+    /// @return The center of the bin that contains the percentile
+    double percentile (const double p) const
+    {
+        assert (p >= 0.0 && p <= 1.0);
+
+        if (n == 0)
+            return std::numeric_limits<double>::quiet_NaN ();
+
+        // Rank of the residual we are looking for
+        const uint64_t rank = std::min (n - 1, static_cast<uint64_t> (p * n));
+        uint64_t total = 0;
+        for (size_t i = 0; i < bins.size (); ++i)
+        {
+            total += bins[i];
+            if (total > rank)
+                return (static_cast<double> (i) - static_cast<double> (bins.size () / 2)) * width;
+        }
+
+        assert (false);
+        return std::numeric_limits<double>::quiet_NaN ();
+    }
+
+    private:
+    double width;
+    double max_abs;
+    uint64_t n;
+    double sum;
+    double sum_sq;
+    double sum_abs;
+    std::vector<uint64_t> bins;
+
+    size_t get_bin (const double r) const
+    {
+        const double x = std::clamp (r, -max_abs, max_abs);
+        return static_cast<size_t> (std::llround (x / width) + static_cast<long long> (bins.size () / 2));
+    }
+};
+
+// Merge statistics in OpenMP reductions
+#pragma omp declare reduction(+ : stats : omp_out.add (omp_in)) \
+    initializer (omp_priv = stats (omp_orig.bin_width (), omp_orig.max_residual ()))
+
+/// @brief Accumulate the residuals of a set of samples in one pass
+/// @param n Number of samples
+/// @param label Function that returns the truth label of a sample
+/// @param estimate Function that returns the estimated elevation of a sample
+/// @param reference Function that returns the reference elevation of a sample
+/// @param cls Only samples with this truth label are used
+///
+/// Samples with a non-finite estimate or reference are skipped
+template<typename F,typename G,typename H>
+stats get_stats (const size_t n, F label, G estimate, H reference, const long cls)
+{
+    stats s;
+
+#pragma omp parallel for reduction(+:s)
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (label (i) != cls)
+            continue;
+
+        const double r = estimate (i) - reference (i);
+        if (std::isfinite (r))
+            s.update (r);
+    }
+
+    return s;
+}
+
+std::string get_header ()
+{
+    std::stringstream ss;
+    ss << "estimate"
+        << "\t" << "n"
+        << "\t" << "bias"
+        << "\t" << "RMSE"
+        << "\t" << "MAE"
+        << "\t" << "p05"
+        << "\t" << "p50"
+        << "\t" << "p95";
+    return ss.str ();
+}
+
+std::string print (const std::string &name, const stats &s)
+{
+    std::stringstream ss;
+    ss << std::setprecision(3) << std::fixed;
+    ss << name
+        << "\t" << s.count ()
+        << "\t" << s.bias ()
+        << "\t" << s.RMSE ()
+        << "\t" << s.MAE ()
+        << "\t" << s.percentile (0.05)
+        << "\t" << s.percentile (0.50)
+        << "\t" << s.percentile (0.95);
+    return ss.str ();
+}
+
+} // namespace residuals
+
+} // namespace oopp
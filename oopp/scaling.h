@@ -0,0 +1,70 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+
+namespace oopp
+{
+
+namespace scaling
+{
+
+/// @brief Get the speedup of a parallel run
+/// @param t1 Time on one thread
+/// @param tp Time on 'p' threads
+double speedup (const double t1, const double tp)
+{
+    return t1 / tp;
+}
+
+/// @brief Get the parallel efficiency
+/// @param s Speedup
+/// @param p Number of threads
+double efficiency (const double s, const size_t p)
+{
+    return s / p;
+}
+
+/// @brief Get the experimentally determined serial fraction
+/// @param s Speedup
+/// @param p Number of threads
+/// @return The Karp-Flatt metric, or NaN on one thread
+///
+/// A serial fraction that grows with 'p' points to parallel overhead,
+/// like synchronization or load imbalance, rather than to serial code.
+double serial_fraction (const double s, const size_t p)
+{
+    if (p < 2)
+        return std::numeric_limits<double>::quiet_NaN ();
+
+    return (1.0 / s - 1.0 / p) / (1.0 - 1.0 / p);
+}
+
+/// @brief Get the default thread counts to try
+/// @param cores Number of cores
+/// @return Powers of two up to the number of cores, and the number of cores
+std::vector<size_t> get_thread_counts (const size_t cores)
+{
+    std::vector<size_t> threads;
+    for (size_t i = 1; i < cores; i *= 2)
+        threads.push_back (i);
+    threads.push_back (std::max (size_t (1), cores));
+    return threads;
+}
+
+/// @brief Get the ways to split cores between processes and threads
+/// @param cores Number of cores
+/// @return Number of processes of each split, from one to 'cores'
+///
+/// Each split uses all of the cores, so only divisors are returned
+std::vector<size_t> get_splits (const size_t cores)
+{
+    std::vector<size_t> processes;
+    for (size_t i = 1; i <= cores; ++i)
+        if (cores % i == 0)
+            processes.push_back (i);
+    return processes;
+}
+
+} // namespace scaling
+
+} // namespace oopp
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/confusion.h"
+
+namespace oopp
+{
+
+namespace scoring
+{
+
+// One-vs-rest confusion matrices, keyed by class
+using confusion_matrices = std::map<long,confusion_matrix>;
+
+/// @brief Get the set of classes to score
+/// @param cls Class to score, or -1 to score all classes
+std::set<long> get_classes (const long cls)
+{
+    if (cls != -1)
+        return std::set<long> { cls };
+
+    return std::set<long> { 0, 40, 41 };
+}
+
+/// @brief Allocate a confusion matrix for each class
+confusion_matrices get_confusion_matrices (const std::set<long> &classes)
+{
+    confusion_matrices cm;
+    for (auto c : classes)
+        cm[c] = confusion_matrix ();
+    return cm;
+}
+
+/// @brief Add matrices to another set of matrices
+void add (confusion_matrices &a, const confusion_matrices &b)
+{
+    for (const auto &i : b)
+        a[i.first].add (i.second);
+}
+
+/// @brief Map a label to the label that it is scored as
+///
+/// Unclassified (1) is scored as unprocessed (0)
+inline long map_label (const long label)
+{
+    return label == 1 ? 0 : label;
+}
+
+/// @brief Allocate a multi-class matrix for a set of classes
+multiclass_confusion_matrix get_multiclass_confusion_matrix (const std::set<long> &classes)
+{
+    return multiclass_confusion_matrix (std::vector<long> (classes.begin (), classes.end ()));
+}
+
+/// @brief Score labels and predictions in a single pass
+/// @param n Number of samples
+/// @param actual Function that returns the truth label of a sample
+/// @param pred Function that returns the prediction of a sample
+/// @param classes Classes to score
+/// @param ignore_cls Truth label to ignore, or -1 to not ignore any
+/// @param ignored Number of samples that were ignored
+template<typename F,typename G>
+multiclass_confusion_matrix get_multiclass_confusion_matrix (const size_t n,
+    F actual,
+    G pred,
+    const std::set<long> &classes,
+    const long ignore_cls,
+    size_t &ignored)
+{
+    auto m = get_multiclass_confusion_matrix (classes);
+    const size_t k = m.size ();
+    uint64_t *counts = m.data ();
+    ignored = 0;
+
+#pragma omp parallel for reduction(+:counts[:k * k]) reduction(+:ignored)
+    for (size_t i = 0; i < n; ++i)
+    {
+        const long a = actual (i);
+
+        // Ignore it?
+        if (a == ignore_cls)
+        {
+            ++ignored;
+            continue;
+        }
+
+        const size_t row = m.get_index (map_label (a));
+        const size_t col = m.get_index (map_label (pred (i)));
+        ++counts[row * k + col];
+    }
+
+    return m;
+}
+
+/// @brief Score the predictions of a set of photons in a single pass
+template<typename T>
+multiclass_confusion_matrix get_multiclass_confusion_matrix (const T &p,
+    const std::set<long> &classes,
+    const long ignore_cls,
+    size_t &ignored)
+{
+    return get_multiclass_confusion_matrix (p.size (),
+        [&](const size_t i) { return static_cast<long> (p[i].cls); },
+        [&](const size_t i) { return static_cast<long> (p[i].prediction); },
+        classes,
+        ignore_cls,
+        ignored);
+}
+
+/// @brief Get one-vs-rest matrices from a multi-class matrix
+confusion_matrices get_confusion_matrices (const multiclass_confusion_matrix &m)
+{
+    confusion_matrices cm;
+    for (auto c : m.get_classes ())
+        cm[c] = m.get_confusion_matrix (c);
+    return cm;
+}
+
+/// @brief Score the predictions of a set of photons
+/// @param p Photons
+/// @param classes Classes to score
+/// @param ignore_cls Truth label to ignore, or -1 to not ignore any
+template<typename T>
+confusion_matrices get_confusion_matrices (const T &p,
+    const std::set<long> &classes,
+    const long ignore_cls)
+{
+    size_t ignored;
+    return get_confusion_matrices (get_multiclass_confusion_matrix (p, classes, ignore_cls, ignored));
+}
+
+std::string get_confusion_matrix_header ()
+{
+    std::stringstream ss;
+    ss << "cls"
+        << "\t" << "acc"
+        << "\t" << "F1"
+        << "\t" << "bal_acc"
+        << "\t" << "cal_F1"
+        << "\t" << "MCC"
+        << "\t" << "Avg"
+        << "\t" << "tp"
+        << "\t" << "tn"
+        << "\t" << "fp"
+        << "\t" << "fn"
+        << "\t" << "support"
+        << "\t" << "total";
+    return ss.str ();
+}
+
+std::string print (const long cls, const confusion_matrix &cm)
+{
+    std::stringstream ss;
+    ss << std::setprecision(3) << std::fixed;
+    ss << cls
+        << "\t" << cm.accuracy ()
+        << "\t" << cm.F1 ()
+        << "\t" << cm.balanced_accuracy ()
+        << "\t" << cm.calibrated_F_beta ()
+        << "\t" << cm.MCC ()
+        << "\t" << (cm.F1 ()
+                    + cm.balanced_accuracy ()
+                    + cm.calibrated_F_beta ()
+                    + cm.MCC ()) / 4.0
+        << "\t" << cm.true_positives ()
+        << "\t" << cm.true_negatives ()
+        << "\t" << cm.false_positives ()
+        << "\t" << cm.false_negatives ()
+        << "\t" << cm.support ()
+        << "\t" << cm.total ();
+
+    return ss.str ();
+}
+
+// Header for per-file results
+std::string get_file_header ()
+{
+    return get_confusion_matrix_header ()
+        + "\tmodel"
+        + "\tfilename"
+        + "\tphotons"
+        + "\tseconds";
+}
+
+/// @brief Print the results for one file, one row per class
+/// @param cm One-vs-rest matrices
+/// @param model Name of the model that made the predictions
+/// @param filename Name of the file that was scored
+/// @param photons Number of photons in the file
+/// @param seconds Time spent on the file
+std::string print_file (const confusion_matrices &cm,
+    const std::string &model,
+    const std::string &filename,
+    const size_t photons,
+    const double seconds)
+{
+    std::stringstream ss;
+    for (const auto &i : cm)
+        ss << print (i.first, i.second)
+            << "\t" << model
+            << "\t" << filename
+            << "\t" << photons
+            << "\t" << std::fixed << std::setprecision(3) << seconds
+            << std::endl;
+    return ss.str ();
+}
+
+// Scores averaged over classes, weighted by each class's support
+struct weighted_scores
+{
+    double accuracy = 0.0;
+    double F1 = 0.0;
+    double bal_acc = 0.0;
+    double cal_F1 = 0.0;
+    double MCC = 0.0;
+};
+
+/// @brief Get scores weighted by each class's support
+///
+/// Classes whose score is undefined are skipped
+weighted_scores get_weighted_scores (const confusion_matrices &cm)
+{
+    using namespace std;
+
+    weighted_scores w;
+    for (const auto &i : cm)
+    {
+        const auto &m = i.second;
+        if (!isnan (m.F1 ()))
+            w.F1 += m.F1 () * m.support () / m.total ();
+        if (!isnan (m.accuracy ()))
+            w.accuracy += m.accuracy () * m.support () / m.total ();
+        if (!isnan (m.balanced_accuracy ()))
+            w.bal_acc += m.balanced_accuracy () * m.support () / m.total ();
+        if (!isnan (m.calibrated_F_beta ()))
+            w.cal_F1 += m.calibrated_F_beta () * m.support () / m.total ();
+        if (!isnan (m.MCC ()))
+            w.MCC += m.MCC () * m.support () / m.total ();
+    }
+    return w;
+}
+
+/// @brief Print the aggregate results
+/// @param cm One-vs-rest matrices
+/// @param weighted Also print scores weighted by each class's support
+std::string print_results (const confusion_matrices &cm, const bool weighted)
+{
+    using namespace std;
+
+    stringstream ss;
+    ss << get_confusion_matrix_header () << endl;
+
+    for (const auto &i : cm)
+        ss << print (i.first, i.second) << endl;
+
+    if (!weighted)
+        return ss.str ();
+
+    const auto w = get_weighted_scores (cm);
+    ss << "weighted_accuracy = " << w.accuracy << endl;
+    ss << "weighted_F1 = " << w.F1 << endl;
+    ss << "weighted_bal_acc = " << w.bal_acc << endl;
+    ss << "weighted_cal_F1 = " << w.cal_F1 << endl;
+    ss << "weighted_MCC = " << w.MCC << endl;
+
+    return ss.str ();
+}
+
+} // namespace scoring
+
+} // namespace oopp
@@ -0,0 +1,428 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cmd_utils.h"
+#include "oopp/oopp.h"
+#include "oopp/scoring.h"
+
+namespace oopp
+{
+
+namespace search
+{
+
+// A parameter and the values that it is searched over
+//
+// A dimension is either a list of values, or a range from 'min' to
+// 'max'. A grid search divides a range into 'points' values, and
+// sampled searches draw from the whole range.
+struct dimension
+{
+    std::string name;
+    std::function<void(params &,double)> set;
+    bool integer = false;
+    std::vector<double> values;
+    double min = 0.0;
+    double max = 0.0;
+    size_t points = 0; // 0 means use the default number of grid points
+};
+
+/// @brief Parse a dimension
+/// @param name Parameter name
+/// @param spec 'a,b,c' for a list, 'a:b' for a range, or 'a:b:n' for
+/// a range with 'n' grid points
+/// @param set Function that assigns a value to a parameter set
+/// @param integer True if the parameter only takes integer values
+template<typename F>
+dimension get_dimension (const std::string &name, const std::string &spec, F set, const bool integer)
+{
+    using namespace std;
+
+    dimension d;
+    d.name = name;
+    d.set = set;
+    d.integer = integer;
+
+    if (spec.find (':') == string::npos)
+    {
+        d.values = cmd::parse_list (spec);
+        if (integer)
+            for (auto &x : d.values)
+                x = round (x);
+        return d;
+    }
+
+    vector<string> fields;
+    stringstream ss (spec);
+    string field;
+    while (getline (ss, field, ':'))
+    {
+        if (field.empty ())
+            throw runtime_error ("Invalid range for " + name + ": '" + spec + "'");
+        fields.push_back (field);
+    }
+
+    if (fields.size () != 2 && fields.size () != 3)
+        throw runtime_error ("Invalid range for " + name + ": '" + spec + "'");
+
+    d.min = atof (fields[0].c_str ());
+    d.max = atof (fields[1].c_str ());
+    if (fields.size () == 3)
+    {
+        d.points = atol (fields[2].c_str ());
+        if (d.points == 0)
+            throw runtime_error ("Invalid number of grid points for " + name + ": '" + spec + "'");
+    }
+
+    if (d.min > d.max)
+        throw runtime_error ("Invalid range for " + name + ": '" + spec + "'");
+
+    if (integer)
+    {
+        d.min = ceil (d.min);
+        d.max = floor (d.max);
+        if (d.min > d.max)
+            throw runtime_error ("Range for " + name + " does not contain an integer: '" + spec + "'");
+    }
+
+    return d;
+}
+
+/// @brief Get the values of a dimension on a grid
+/// @param d Dimension
+/// @param points Number of points in a range, unless the dimension has its own
+///
+/// Integer ranges default to every integer in the range
+std::vector<double> get_grid_values (const dimension &d, const size_t points)
+{
+    using namespace std;
+
+    if (!d.values.empty ())
+        return d.values;
+
+    size_t n = d.points;
+    if (n == 0)
+        n = d.integer ? static_cast<size_t> (d.max - d.min) + 1 : points;
+    assert (n != 0);
+
+    vector<double> values;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const double x = (n == 1) ? d.min : d.min + i * (d.max - d.min) / (n - 1);
+        values.push_back (d.integer ? round (x) : x);
+    }
+
+    // Rounding can make integer values repeat
+    values.erase (unique (values.begin (), values.end ()), values.end ());
+
+    return values;
+}
+
+/// @brief Map a number in [0, 1) to a value of a dimension
+///
+/// Every list value, and every integer in a range, is equally likely
+double get_value (const dimension &d, const double u)
+{
+    using namespace std;
+
+    assert (u >= 0.0 && u < 1.0);
+
+    if (!d.values.empty ())
+        return d.values[min (d.values.size () - 1, static_cast<size_t> (u * d.values.size ()))];
+
+    if (d.integer)
+        return min (d.max, floor (d.min + u * (d.max - d.min + 1.0)));
+
+    return d.min + u * (d.max - d.min);
+}
+
+/// @brief Get every combination of grid values
+/// @param base Values of the parameters that are not searched
+/// @param dims Dimensions
+/// @param points Default number of grid points in a range
+///
+/// The last dimension varies fastest
+template<typename T>
+std::vector<T> get_grid (const T &base, const std::vector<dimension> &dims, const size_t points)
+{
+    std::vector<T> p { base };
+    for (const auto &d : dims)
+    {
+        const auto values = get_grid_values (d, points);
+        std::vector<T> tmp;
+        tmp.reserve (p.size () * values.size ());
+        for (const auto &i : p)
+        {
+            for (auto x : values)
+            {
+                tmp.push_back (i);
+                d.set (tmp.back (), x);
+            }
+        }
+        p.swap (tmp);
+    }
+    return p;
+}
+
+/// @brief Get uniformly random samples
+/// @param base Values of the parameters that are not searched
+/// @param dims Dimensions
+/// @param n Number of samples
+/// @param seed Random seed
+template<typename T>
+std::vector<T> get_random (const T &base, const std::vector<dimension> &dims, const size_t n, const unsigned seed)
+{
+    std::mt19937 rng (seed);
+    std::uniform_real_distribution<> u (0.0, 1.0);
+
+    std::vector<T> p (n, base);
+    for (auto &i : p)
+        for (const auto &d : dims)
+            d.set (i, get_value (d, u (rng)));
+    return p;
+}
+
+/// @brief Get Latin hypercube samples
+/// @param base Values of the parameters that are not searched
+/// @param dims Dimensions
+/// @param n Number of samples
+/// @param seed Random seed
+///
+/// Each dimension is divided into 'n' equal strata, and each stratum
+/// is sampled exactly once, so every dimension is covered evenly no
+/// matter how few samples are taken.
+template<typename T>
+std::vector<T> get_latin_hypercube (const T &base, const std::vector<dimension> &dims, const size_t n, const unsigned seed)
+{
+    std::mt19937 rng (seed);
+    std::uniform_real_distribution<> u (0.0, 1.0);
+
+    std::vector<T> p (n, base);
+    std::vector<size_t> strata (n);
+    for (const auto &d : dims)
+    {
+        std::iota (strata.begin (), strata.end (), 0);
+        std::shuffle (strata.begin (), strata.end (), rng);
+        for (size_t i = 0; i < n; ++i)
+        {
+            // Guard against rounding up to the next stratum
+            const double x = std::min ((strata[i] + u (rng)) / n, std::nextafter (1.0, 0.0));
+            d.set (p[i], get_value (d, x));
+        }
+    }
+    return p;
+}
+
+// The metrics that configurations can be ranked by
+const std::vector<std::string> metrics { "acc", "F1", "bal_acc", "cal_F1", "MCC", "Avg" };
+
+/// @brief Get the scores of one class
+/// @param cms One-vs-rest matrices
+/// @param cls Class, or -1 for scores weighted by each class's support
+scoring::weighted_scores get_scores (const scoring::confusion_matrices &cms, const long cls)
+{
+    using namespace std;
+
+    if (cls == -1)
+        return scoring::get_weighted_scores (cms);
+
+    const auto i = cms.find (cls);
+    if (i == cms.end ())
+        throw runtime_error ("Class " + to_string (cls) + " was not scored");
+
+    const auto &m = i->second;
+    scoring::weighted_scores s;
+    s.accuracy = m.accuracy ();
+    s.F1 = m.F1 ();
+    s.bal_acc = m.balanced_accuracy ();
+    s.cal_F1 = m.calibrated_F_beta ();
+    s.MCC = m.MCC ();
+    return s;
+}
+
+/// @brief Get one metric from a set of scores
+/// @param s Scores
+/// @param metric One of 'metrics'
+double get_score (const scoring::weighted_scores &s, const std::string &metric)
+{
+    if (metric == "acc")
+        return s.accuracy;
+    if (metric == "F1")
+        return s.F1;
+    if (metric == "bal_acc")
+        return s.bal_acc;
+    if (metric == "cal_F1")
+        return s.cal_F1;
+    if (metric == "MCC")
+        return s.MCC;
+    if (metric == "Avg")
+        return (s.F1 + s.bal_acc + s.cal_F1 + s.MCC) / 4.0;
+
+    throw std::runtime_error ("Unknown metric: '" + metric + "'");
+}
+
+/// @brief Rank configurations by score
+/// @param scores Score of each configuration
+/// @return Indexes into 'scores', best first
+///
+/// Undefined scores are ranked last, and ties keep their order
+std::vector<size_t> get_ranking (const std::vector<double> &scores)
+{
+    std::vector<size_t> order (scores.size ());
+    std::iota (order.begin (), order.end (), 0);
+    std::stable_sort (order.begin (), order.end (),
+        [&](const size_t a, const size_t b) {
+            if (std::isnan (scores[b]))
+                return !std::isnan (scores[a]);
+            return scores[a] > scores[b]; });
+    return order;
+}
+
+/// @brief Rank configurations that were evaluated on different numbers of files
+/// @param scores Score of each configuration
+/// @param files Number of files that each configuration was evaluated on
+/// @return Indexes into 'scores', best first
+///
+/// Scores on different numbers of files are not comparable, so
+/// configurations that were evaluated on more files rank higher
+std::vector<size_t> get_ranking (const std::vector<double> &scores, const std::vector<size_t> &files)
+{
+    assert (scores.size () == files.size ());
+
+    auto order = get_ranking (scores);
+    std::stable_sort (order.begin (), order.end (),
+        [&](const size_t a, const size_t b) { return files[a] > files[b]; });
+    return order;
+}
+
+// One round of successive halving
+struct rung
+{
+    size_t configs; // Number of configurations evaluated
+    size_t files; // Number of files they have been evaluated on, in total
+};
+
+/// @brief Get the rungs of a successive halving search
+/// @param configs Number of configurations
+/// @param files Number of files
+/// @param min_files Number of files in the first rung
+/// @param eta Factor by which the configurations shrink, and the files grow
+///
+/// The last rung evaluates the survivors on all of the files. Once a
+/// single configuration is left, it goes straight to the last rung.
+std::vector<rung> get_rungs (const size_t configs, const size_t files, const size_t min_files, const double eta)
+{
+    using namespace std;
+
+    if (eta <= 1.0)
+        throw runtime_error ("The halving factor must be greater than 1");
+
+    vector<rung> rungs;
+    if (configs == 0 || files == 0)
+        return rungs;
+
+    double c = configs;
+    double f = clamp (min_files, size_t (1), files);
+    while (rungs.empty () || rungs.back ().files != files)
+    {
+        rung r { max (size_t (1), static_cast<size_t> (ceil (c))),
+            min (files, static_cast<size_t> (round (f))) };
+
+        // Each rung adds at least one file
+        if (!rungs.empty ())
+            r.files = max (r.files, rungs.back ().files + 1);
+
+        if (r.configs == 1)
+            r.files = files;
+
+        rungs.push_back (r);
+        c /= eta;
+        f *= eta;
+    }
+
+    return rungs;
+}
+
+/// @brief Run a successive halving search
+/// @param rungs Rungs from get_rungs()
+/// @param evaluate Function that evaluates configurations on more files
+/// @param score Function that returns a configuration's score so far
+/// @return Indexes of the configurations in the last rung, best first
+///
+/// 'evaluate (indexes, first, last)' evaluates the configurations in
+/// 'indexes' on files 'first' through 'last - 1', and adds the results
+/// to what they have been evaluated on so far. Before each rung, only
+/// the best configurations are kept.
+template<typename E,typename S>
+std::vector<size_t> successive_halving (const std::vector<rung> &rungs, E evaluate, S score)
+{
+    using namespace std;
+
+    if (rungs.empty ())
+        return vector<size_t> ();
+
+    vector<size_t> alive (rungs[0].configs);
+    iota (alive.begin (), alive.end (), 0);
+
+    size_t files = 0;
+    for (const auto &r : rungs)
+    {
+        // Keep the best
+        if (r.configs < alive.size ())
+        {
+            vector<double> scores (alive.size ());
+            for (size_t i = 0; i < alive.size (); ++i)
+                scores[i] = score (alive[i]);
+            const auto order = get_ranking (scores);
+
+            vector<size_t> tmp (r.configs);
+            for (size_t i = 0; i < tmp.size (); ++i)
+                tmp[i] = alive[order[i]];
+            alive.swap (tmp);
+        }
+
+        evaluate (alive, files, r.files);
+        files = r.files;
+    }
+
+    vector<double> scores (alive.size ());
+    for (size_t i = 0; i < alive.size (); ++i)
+        scores[i] = score (alive[i]);
+
+    vector<size_t> ranked;
+    for (auto i : get_ranking (scores))
+        ranked.push_back (alive[i]);
+
+    return ranked;
+}
+
+std::string get_scores_header ()
+{
+    std::stringstream ss;
+    ss << "cls"
+        << "\t" << "acc"
+        << "\t" << "F1"
+        << "\t" << "bal_acc"
+        << "\t" << "cal_F1"
+        << "\t" << "MCC"
+        << "\t" << "Avg";
+    return ss.str ();
+}
+
+std::string print (const long cls, const scoring::weighted_scores &s)
+{
+    std::stringstream ss;
+    ss << std::setprecision(3) << std::fixed;
+    ss << cls
+        << "\t" << s.accuracy
+        << "\t" << s.F1
+        << "\t" << s.bal_acc
+        << "\t" << s.cal_F1
+        << "\t" << s.MCC
+        << "\t" << get_score (s, "Avg");
+    return ss.str ();
+}
+
+} // namespace search
+
+} // namespace oopp
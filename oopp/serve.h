@@ -0,0 +1,375 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/dataframe.h"
+#include "oopp/oopp.h"
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace oopp
+{
+
+namespace serve
+{
+
+// Requests and responses are frames:
+//
+//     uint32_t type
+//     uint64_t payload size in bytes
+//     payload
+//
+// A request's type gives the format of its track, and its response
+// has the same format. A response with the 'error' type holds a
+// message instead. Integers and doubles are in the host's byte order,
+// because clients run on the same machine.
+
+// A track in CSV format: the request holds the input file, and the
+// response holds the predictions file
+const uint32_t CSV = 0;
+
+// A track in binary format: the request holds a uint64_t photon count,
+// followed by arrays of uint64_t index_ph, double x_atc and double
+// geoid_corr_h; the response holds the photon count, followed by
+// arrays of uint8_t prediction, double sea_surface_h and double bathy_h
+const uint32_t BINARY = 1;
+
+// An error message
+const uint32_t ERROR = 2;
+
+// Requests larger than this are rejected by default. That is room for
+// about 10 million photons in CSV format, or 40 million in binary.
+const uint64_t MAX_PAYLOAD = uint64_t (1) << 30;
+
+struct frame
+{
+    uint32_t type = CSV;
+    std::string payload;
+};
+
+namespace detail
+{
+
+// Read exactly 'n' bytes, returning false if the stream ends first
+inline bool read_all (const int fd, void *data, const size_t n)
+{
+    auto p = reinterpret_cast<char *> (data);
+    size_t total = 0;
+    while (total < n)
+    {
+        const auto rc = ::read (fd, p + total, n - total);
+        if (rc == 0)
+            return false;
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                throw std::runtime_error ("Timed out reading frame");
+            throw std::runtime_error (std::string ("Could not read frame: ") + strerror (errno));
+        }
+        total += rc;
+    }
+    return true;
+}
+
+inline void write_all (const int fd, const void *data, const size_t n)
+{
+    auto p = reinterpret_cast<const char *> (data);
+    size_t total = 0;
+    while (total < n)
+    {
+        const auto rc = ::write (fd, p + total, n - total);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                throw std::runtime_error ("Timed out writing frame");
+            throw std::runtime_error (std::string ("Could not write frame: ") + strerror (errno));
+        }
+        total += rc;
+    }
+}
+
+template<typename T>
+void append (std::string &s, const T &x)
+{
+    s.append (reinterpret_cast<const char *> (&x), sizeof (T));
+}
+
+template<typename T>
+T extract (const std::string &s, size_t &offset)
+{
+    if (offset + sizeof (T) > s.size ())
+        throw std::runtime_error ("Binary track is truncated");
+    T x;
+    memcpy (&x, s.data () + offset, sizeof (T));
+    offset += sizeof (T);
+    return x;
+}
+
+} // namespace detail
+
+/// @brief Read a frame
+/// @param fd File descriptor
+/// @param f Frame
+/// @param max_payload Largest payload to accept, in bytes
+/// @return False if the stream ended before the frame started
+///
+/// The payload is read in chunks, so a header that promises more than
+/// is sent does not allocate more than was sent.
+bool read_frame (const int fd, frame &f, const uint64_t max_payload = MAX_PAYLOAD)
+{
+    uint32_t type;
+    if (!detail::read_all (fd, &type, sizeof (type)))
+        return false;
+
+    uint64_t n;
+    if (!detail::read_all (fd, &n, sizeof (n)))
+        throw std::runtime_error ("Frame is truncated");
+
+    if (n > max_payload)
+        throw std::runtime_error ("Frame is too large");
+
+    f.type = type;
+    f.payload.clear ();
+    const size_t chunk_size = 1 << 20;
+    while (f.payload.size () < n)
+    {
+        const size_t offset = f.payload.size ();
+        const size_t m = std::min<uint64_t> (chunk_size, n - offset);
+        f.payload.resize (offset + m);
+        if (!detail::read_all (fd, f.payload.data () + offset, m))
+            throw std::runtime_error ("Frame is truncated");
+    }
+
+    return true;
+}
+
+void write_frame (const int fd, const uint32_t type, const std::string &payload)
+{
+    const uint64_t n = payload.size ();
+    std::string header;
+    detail::append (header, type);
+    detail::append (header, n);
+    detail::write_all (fd, header.data (), header.size ());
+    detail::write_all (fd, payload.data (), payload.size ());
+}
+
+/// @brief Encode the fields of a track that classification depends on
+template<typename T>
+std::string encode_photons (const T &p)
+{
+    std::string s;
+    s.reserve (sizeof (uint64_t) + p.size () * 3 * sizeof (double));
+    detail::append (s, static_cast<uint64_t> (p.size ()));
+    for (const auto &i : p)
+        detail::append (s, static_cast<uint64_t> (i.h5_index));
+    for (const auto &i : p)
+        detail::append (s, i.x);
+    for (const auto &i : p)
+        detail::append (s, i.z);
+    return s;
+}
+
+std::vector<photon> decode_photons (const std::string &s)
+{
+    size_t offset = 0;
+    const auto n = detail::extract<uint64_t> (s, offset);
+    if (n > s.size () || s.size () != sizeof (uint64_t) + n * (sizeof (uint64_t) + 2 * sizeof (double)))
+        throw std::runtime_error ("Binary track has the wrong size");
+
+    std::vector<photon> p (n, photon { 0, 0.0, 0.0, 0, 0, 0.0, 0.0 });
+    for (auto &i : p)
+        i.h5_index = detail::extract<uint64_t> (s, offset);
+    for (auto &i : p)
+        i.x = detail::extract<double> (s, offset);
+    for (auto &i : p)
+        i.z = detail::extract<double> (s, offset);
+    return p;
+}
+
+/// @brief Encode the prediction columns of a classified track
+template<typename T>
+std::string encode_predictions (const T &p)
+{
+    std::string s;
+    s.reserve (sizeof (uint64_t) + p.size () * (sizeof (uint8_t) + 2 * sizeof (double)));
+    detail::append (s, static_cast<uint64_t> (p.size ()));
+    for (const auto &i : p)
+        detail::append (s, static_cast<uint8_t> (i.prediction));
+    for (const auto &i : p)
+        detail::append (s, i.surface_elevation);
+    for (const auto &i : p)
+        detail::append (s, i.bathy_elevation);
+    return s;
+}
+
+/// @brief Fill in the prediction columns of a track
+template<typename T>
+void decode_predictions (const std::string &s, T &p)
+{
+    size_t offset = 0;
+    const auto n = detail::extract<uint64_t> (s, offset);
+    if (n != p.size () || s.size () != sizeof (uint64_t) + n * (sizeof (uint8_t) + 2 * sizeof (double)))
+        throw std::runtime_error ("Predictions have the wrong size");
+
+    for (auto &i : p)
+        i.prediction = detail::extract<uint8_t> (s, offset);
+    for (auto &i : p)
+        i.surface_elevation = detail::extract<double> (s, offset);
+    for (auto &i : p)
+        i.bathy_elevation = detail::extract<double> (s, offset);
+}
+
+/// @brief Answer requests until the input ends
+/// @param in File descriptor that requests are read from
+/// @param out File descriptor that responses are written to
+/// @param f Function that classifies a track in place
+/// @param max_payload Largest request to accept, in bytes
+/// @return Number of requests answered
+///
+/// A request that can't be classified gets an error response, and the
+/// server goes on to the next request.
+template<typename F>
+size_t serve (const int in, const int out, F f, const uint64_t max_payload = MAX_PAYLOAD)
+{
+    using namespace std;
+
+    size_t requests = 0;
+    frame request;
+    while (read_frame (in, request, max_payload))
+    {
+        uint32_t type = request.type;
+        string response;
+        try
+        {
+            if (request.type == CSV)
+            {
+                istringstream is (request.payload);
+                const auto df = dataframe::read_buffered (is);
+
+                // The conversion only asserts these
+                if (!df.is_valid () || df.rows () == 0 || df.cols () == 0)
+                    throw runtime_error ("Track has no photons");
+
+                auto p = dataframe::convert_dataframe (df);
+                f (p);
+                ostringstream os;
+                write_predictions (os, p);
+                response = os.str ();
+            }
+            else if (request.type == BINARY)
+            {
+                auto p = decode_photons (request.payload);
+                if (p.empty ())
+                    throw runtime_error ("Track has no photons");
+                f (p);
+                response = encode_predictions (p);
+            }
+            else
+            {
+                throw runtime_error ("Unknown request type " + to_string (request.type));
+            }
+        }
+        catch (const exception &e)
+        {
+            type = ERROR;
+            response = e.what ();
+        }
+
+        // Don't hold on to a large request while waiting for the next one
+        string ().swap (request.payload);
+
+        write_frame (out, type, response);
+        ++requests;
+    }
+
+    return requests;
+}
+
+// Get a Unix domain socket address
+sockaddr_un get_address (const std::string &path)
+{
+    sockaddr_un addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size () >= sizeof (addr.sun_path))
+        throw std::runtime_error ("Socket path is too long");
+    strncpy (addr.sun_path, path.c_str (), sizeof (addr.sun_path) - 1);
+    return addr;
+}
+
+/// @brief Listen on a Unix domain socket, replacing any stale socket file
+/// @return Listening file descriptor
+///
+/// Anything at 'path' that is not a socket is left alone, and listening
+/// fails instead.
+int listen (const std::string &path)
+{
+    const auto addr = get_address (path);
+
+    struct stat st;
+    if (::lstat (path.c_str (), &st) == 0)
+    {
+        if (!S_ISSOCK (st.st_mode))
+            throw std::runtime_error ("Could not listen on " + path + ": File exists and is not a socket");
+        ::unlink (path.c_str ());
+    }
+
+    const int fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        throw std::runtime_error ("Could not create a socket");
+
+    if (::bind (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) != 0
+        || ::listen (fd, 16) != 0)
+    {
+        ::close (fd);
+        throw std::runtime_error ("Could not listen on " + path + ": " + strerror (errno));
+    }
+
+    return fd;
+}
+
+/// @brief Give up on a connection that stops sending or receiving
+/// @param fd Connected file descriptor
+/// @param seconds Longest wait for any read or write, 0 to wait forever
+///
+/// A read or write that waits longer throws, so one stalled client
+/// can't hold up the clients waiting behind it.
+void set_timeout (const int fd, const double seconds)
+{
+    timeval tv;
+    tv.tv_sec = static_cast<time_t> (seconds);
+    tv.tv_usec = static_cast<suseconds_t> ((seconds - tv.tv_sec) * 1'000'000);
+    if (::setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv)) != 0
+        || ::setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv)) != 0)
+        throw std::runtime_error (std::string ("Could not set the socket timeout: ") + strerror (errno));
+}
+
+/// @brief Connect to a server's Unix domain socket
+/// @return Connected file descriptor
+int connect (const std::string &path)
+{
+    const auto addr = get_address (path);
+
+    const int fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        throw std::runtime_error ("Could not create a socket");
+
+    if (::connect (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) != 0)
+    {
+        ::close (fd);
+        throw std::runtime_error ("Could not connect to " + path + ": " + strerror (errno));
+    }
+
+    return fd;
+}
+
+} // namespace serve
+
+} // namespace oopp
@@ -0,0 +1,671 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/cache.h"
+#include "oopp/oopp.h"
+
+namespace oopp
+{
+
+namespace state
+{
+
+// A peak in a window's smoothed vertical PMF
+struct peak
+{
+    uint32_t bin;
+    // Number of photons within 1m of the peak's elevation
+    uint32_t total;
+    // Shape of the photon distribution within 1m of the peak
+    double mean;
+    double variance;
+};
+
+// The part of a window's estimates that does not depend on the
+// surface/bathy thresholds
+struct window
+{
+    // Photon indexes, ordered by vertical bin
+    std::vector<uint32_t> indexes;
+    // Offset into 'indexes' of each vertical bin
+    std::vector<uint32_t> offsets;
+    // Peaks of the smoothed vertical PMF
+    std::vector<peak> peaks;
+
+    size_t bin_size (const size_t i) const
+    {
+        assert (i + 1 < offsets.size ());
+        return offsets[i + 1] - offsets[i];
+    }
+};
+
+// The part of a track's estimates that does not depend on the
+// surface/bathy thresholds
+struct track
+{
+    // The parameters that the state depends on
+    double x_resolution = 0.0;
+    double z_resolution = 0.0;
+    double z_min = 0.0;
+    double z_max = 0.0;
+    double surface_z_min = 0.0;
+    double surface_z_max = 0.0;
+    double vertical_smoothing_sigma = 0.0;
+    double min_peak_prominence = 0.0;
+    uint64_t min_peak_distance = 0;
+    // Number of photons in the track
+    uint64_t total_photons = 0;
+    // Hash of the photons' indexes and coordinates
+    uint64_t photons_hash = 0;
+    // Global surface estimate
+    surface_estimate se { 0.0, 0.0 };
+    // Along-track windows
+    std::vector<window> windows;
+};
+
+// Allow a track's windows to be used like h_bins
+struct h_bins_view
+{
+    const std::vector<window> &windows;
+    size_t size () const { return windows.size (); }
+    const std::vector<uint32_t> &operator[] (const size_t i) const { return windows[i].indexes; }
+};
+
+/// @brief Get the first and last+1 vertical bins that can contain elevations within a range
+template<typename T>
+std::pair<size_t,size_t> get_bin_range (const double z0, const double z1, const size_t total_bins, const T &params)
+{
+    // Pad by a bin on each side to avoid rounding problems
+    const double b0 = std::floor ((z0 - params.z_min) / params.z_resolution) - 1.0;
+    const double b1 = std::floor ((z1 - params.z_min) / params.z_resolution) + 2.0;
+    const size_t i0 = b0 < 0.0 ? 0 : std::min (static_cast<size_t> (b0), total_bins);
+    const size_t i1 = b1 < 0.0 ? 0 : std::min (static_cast<size_t> (b1), total_bins);
+    return { i0, i1 };
+}
+
+/// @brief Get the threshold-independent state of a single window
+template<typename T,typename U,typename V,typename W>
+window get_window (const T &p,
+    const U &v_bins,
+    const V &v_bin_elevations,
+    const W &params)
+{
+    using namespace std;
+    using namespace oopp::utils;
+
+    window w;
+
+    // Flatten the vertical bins
+    w.offsets.resize (v_bins.size () + 1);
+    for (size_t i = 0; i < v_bins.size (); ++i)
+    {
+        w.offsets[i] = w.indexes.size ();
+        w.indexes.insert (w.indexes.end (), v_bins[i].begin (), v_bins[i].end ());
+    }
+    w.offsets[v_bins.size ()] = w.indexes.size ();
+
+    // Get a histogram from the bin indexes
+    vector<size_t> h (v_bins.size ());
+
+    transform (v_bins.begin (), v_bins.end (), h.begin (),
+        [&](const auto &b) { return b.size (); });
+
+    // Convert the histogram to a probability mass function
+    auto pmf = convert_to_pmf<double> (h);
+
+    // Smooth it
+    pmf = gaussian_1D_filter (pmf, params.vertical_smoothing_sigma);
+
+    // Get peak bin indexes from the PMF
+    const auto peak_v_bin_indexes = find_peaks (pmf,
+        params.min_peak_prominence,
+        params.min_peak_distance);
+
+    // Get the shape of the photon distribution near each peak
+    const double max_distance = 1.0; // meters
+    for (auto i : peak_v_bin_indexes)
+    {
+        assert (i < v_bin_elevations.size ());
+        const double elevation = v_bin_elevations[i];
+        const auto r = get_bin_range (elevation - max_distance, elevation + max_distance, v_bins.size (), params);
+
+        vector<double> z;
+        for (size_t j = r.first; j < r.second; ++j)
+        {
+            for (auto k : v_bins[j])
+            {
+                assert (k < p.size ());
+                if (fabs (p[k].z - elevation) < max_distance)
+                    z.push_back (p[k].z);
+            }
+        }
+
+        w.peaks.push_back (peak {
+            static_cast<uint32_t> (i),
+            static_cast<uint32_t> (z.size ()),
+            mean (z),
+            variance (z) });
+    }
+
+    return w;
+}
+
+// The state refers to photons by index, so it can only be used with
+// the photons that it was saved from
+template<typename T>
+uint64_t get_photons_hash (const T &p)
+{
+    cache::hasher h;
+    cache::update (h, p);
+    return h.get ();
+}
+
+/// @brief Get the threshold-independent state of a track
+template<typename T,typename U>
+track get_track (const T &p, const U &params)
+{
+    using namespace std;
+
+    // Indexes are saved as 32 bit values
+    if (p.size () > numeric_limits<uint32_t>::max ())
+        throw runtime_error ("Too many photons to save state");
+
+    // The state is saved per window
+    if (has_overlapping_windows (params))
+        throw runtime_error ("Can't save state when windows overlap");
+
+    track t;
+    t.x_resolution = params.x_resolution;
+    t.z_resolution = params.z_resolution;
+    t.z_min = params.z_min;
+    t.z_max = params.z_max;
+    t.surface_z_min = params.surface_z_min;
+    t.surface_z_max = params.surface_z_max;
+    t.vertical_smoothing_sigma = params.vertical_smoothing_sigma;
+    t.min_peak_prominence = params.min_peak_prominence;
+    t.min_peak_distance = params.min_peak_distance;
+    t.total_photons = p.size ();
+    t.photons_hash = get_photons_hash (p);
+    t.se = get_surface_estimate (p, params);
+
+    const auto h_bins = get_h_bins (p, params);
+    const auto v_bin_elevations = get_v_bin_elevations (params);
+    t.windows.resize (h_bins.size ());
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < h_bins.size (); ++i)
+    {
+        // If there are no photons in the h_bin, there is nothing to do
+        if (h_bins[i].empty ())
+            continue;
+
+        const auto v_bins = get_v_bins (p, h_bins[i], params);
+        t.windows[i] = get_window (p, v_bins, v_bin_elevations, params);
+    }
+
+    return t;
+}
+
+/// @brief Check whether a track's state can be used with a set of photons and parameters
+template<typename T,typename U>
+bool is_compatible (const track &t, const T &p, const U &params)
+{
+    return !has_overlapping_windows (params)
+        && t.x_resolution == params.x_resolution
+        && t.z_resolution == params.z_resolution
+        && t.z_min == params.z_min
+        && t.z_max == params.z_max
+        && t.surface_z_min == params.surface_z_min
+        && t.surface_z_max == params.surface_z_max
+        && t.vertical_smoothing_sigma == params.vertical_smoothing_sigma
+        && t.min_peak_prominence == params.min_peak_prominence
+        && t.min_peak_distance == params.min_peak_distance
+        && t.total_photons == p.size ()
+        && t.photons_hash == get_photons_hash (p);
+}
+
+/// @brief Select surface photons from a window's state
+///
+/// This makes the same selections as oopp::get_surface_indexes().
+template<typename T,typename U,typename V>
+std::vector<size_t> get_surface_indexes (const T &p,
+    const surface_estimate &se,
+    const window &w,
+    const U &v_bin_elevations,
+    const V &params)
+{
+    using namespace std;
+
+    // Eliminate peaks that can't be surface
+    const double surface_z_min = se.mean - params.surface_n_stddev * sqrt (se.variance);
+    const double surface_z_max = se.mean + params.surface_n_stddev * sqrt (se.variance);
+    vector<size_t> peak_indexes;
+    for (size_t i = 0; i < w.peaks.size (); ++i)
+    {
+        const size_t bin = w.peaks[i].bin;
+        assert (bin < v_bin_elevations.size ());
+        if (v_bin_elevations[bin] < surface_z_min)
+            continue;
+        if (v_bin_elevations[bin] > surface_z_max)
+            continue;
+        peak_indexes.push_back (i);
+    }
+
+    // Return value
+    vector<size_t> indexes;
+
+    // If there are no peaks, there is nothing to do
+    if (peak_indexes.empty ())
+        return indexes;
+
+    // Set a sentinel
+    size_t surface_peak = w.peaks.size ();
+
+    // If there is only one peak, it is the surface estimate
+    if (peak_indexes.size () == 1)
+    {
+        surface_peak = peak_indexes[0];
+    }
+    else
+    {
+        // Get the two highest peaks
+        nth_element (peak_indexes.begin (),
+            peak_indexes.begin () + 1,
+            peak_indexes.end (),
+            [&](auto a, auto b) {
+                return w.bin_size (w.peaks[a].bin) > w.bin_size (w.peaks[b].bin); });
+
+        const size_t bin0 = w.peaks[peak_indexes[0]].bin;
+        const size_t bin1 = w.peaks[peak_indexes[1]].bin;
+        const size_t size0 = w.bin_size (bin0);
+        const size_t size1 = w.bin_size (bin1);
+
+        // If they are close in height...
+        if (std::min (size0, size1) > std::max (size0, size1) / 3)
+        {
+            // ... use the one at the highest elevation
+            if (v_bin_elevations[bin0] > v_bin_elevations[bin1])
+                surface_peak = peak_indexes[0];
+            else
+                surface_peak = peak_indexes[1];
+        }
+        else
+        {
+            // ... otherwise, use largest one
+            if (size0 > size1)
+                surface_peak = peak_indexes[0];
+            else
+                surface_peak = peak_indexes[1];
+        }
+    }
+
+    assert (surface_peak < w.peaks.size ());
+    const auto &s = w.peaks[surface_peak];
+
+    // Short circuit if needed
+    if (s.total == 0)
+        return indexes;
+
+    // Get the indexes of all photons within N standard deviations of
+    // the surface estimate
+    const double d = sqrt (s.variance) * params.surface_n_stddev;
+    const size_t total_bins = w.offsets.size () - 1;
+    const auto r = get_bin_range (s.mean - d, s.mean + d, total_bins, params);
+    for (size_t i = w.offsets[r.first]; i < w.offsets[r.second]; ++i)
+    {
+        const size_t j = w.indexes[i];
+        assert (j < p.size ());
+        if (fabs (p[j].z - s.mean) < d)
+            indexes.push_back (j);
+    }
+
+    // Check to make sure we have enough
+    if (indexes.size () < params.min_surface_photons_per_window)
+        indexes.clear ();
+
+    return indexes;
+}
+
+/// @brief Select bathy photons from a window's state
+///
+/// This makes the same selections as oopp::get_bathy_indexes().
+template<typename T,typename U,typename V>
+std::vector<size_t> get_bathy_indexes (const T &p,
+    const surface_estimate &se,
+    const window &w,
+    const U &v_bin_elevations,
+    const V &params)
+{
+    using namespace std;
+    using namespace oopp::utils;
+
+    // Only photons below this elevation can be bathy
+    const double z_min = se.mean - params.bathy_n_stddev * sqrt (se.variance);
+    const size_t total_bins = w.offsets.size () - 1;
+
+    // Keep track of which photons are below the surface
+    vector<uint32_t> subsurface;
+    vector<uint32_t> offsets (total_bins + 1);
+
+    // Bins above this one can't contain subsurface photons
+    const size_t last_bin = get_bin_range (z_min, z_min, total_bins, params).second;
+
+    for (size_t i = 0; i < total_bins; ++i)
+    {
+        offsets[i] = subsurface.size ();
+        if (i >= last_bin)
+            continue;
+        for (size_t j = w.offsets[i]; j < w.offsets[i + 1]; ++j)
+        {
+            const size_t index = w.indexes[j];
+            assert (index < p.size ());
+            if (p[index].z < z_min)
+                subsurface.push_back (index);
+        }
+    }
+    offsets[total_bins] = subsurface.size ();
+
+    // Return value
+    vector<size_t> indexes;
+
+    // If there are none, there is nothing to do
+    if (subsurface.empty ())
+        return indexes;
+
+    // Get a histogram from the subsurface photons
+    vector<size_t> h (total_bins);
+    for (size_t i = 0; i < total_bins; ++i)
+        h[i] = offsets[i + 1] - offsets[i];
+
+    // Convert the histogram to a probability mass function
+    auto pmf = convert_to_pmf<double> (h);
+
+    // Smooth it
+    pmf = gaussian_1D_filter (pmf, params.vertical_smoothing_sigma);
+
+    // Get peak bin indexes from the PMF
+    const auto peak_v_bin_indexes = find_peaks (pmf,
+        params.min_peak_prominence,
+        params.min_peak_distance);
+
+    // We need at least one peak
+    if (peak_v_bin_indexes.empty ())
+        return indexes;
+
+    // Use the highest peak
+    const size_t bathy_bin_index = *max_element (peak_v_bin_indexes.begin (),
+        peak_v_bin_indexes.end (),
+        [&](auto a, auto b) { return h[a] < h[b]; });
+
+    // Get the elevation of the bathy estimate
+    assert (bathy_bin_index < v_bin_elevations.size ());
+    const double bathy_elevation = v_bin_elevations[bathy_bin_index];
+
+    // Get all photons within a certain range of the bathy elevation
+    const double max_distance = 1.0; // meters
+    vector<double> bathy_photons;
+
+    auto r = get_bin_range (bathy_elevation - max_distance, bathy_elevation + max_distance, total_bins, params);
+    for (size_t i = offsets[r.first]; i < offsets[r.second]; ++i)
+    {
+        const size_t j = subsurface[i];
+        const double d = fabs (p[j].z - bathy_elevation);
+        if (d < max_distance)
+            bathy_photons.push_back (p[j].z);
+    }
+
+    // Short circuit if needed
+    if (bathy_photons.empty ())
+        return indexes;
+
+    // Get shape of photon distribution near the bathy estimate
+    const double u = mean (bathy_photons);
+    const double v = variance (bathy_photons);
+
+    // Get the indexes of all photons within some standard deviations
+    // of the bathy estimate
+    const double d = sqrt (v) * params.bathy_n_stddev;
+    r = get_bin_range (u - d, u + d, total_bins, params);
+    for (size_t i = offsets[r.first]; i < offsets[r.second]; ++i)
+    {
+        const size_t j = subsurface[i];
+        if (fabs (p[j].z - u) < d)
+            indexes.push_back (j);
+    }
+
+    // Check to make sure we have enough
+    if (indexes.size () < params.min_bathy_photons_per_window)
+        indexes.clear ();
+
+    return indexes;
+}
+
+/// @brief Get surface and bathy estimates from a window's state
+template<typename T,typename U,typename V>
+estimates get_estimates (const T &p,
+    const surface_estimate &se,
+    const window &w,
+    const U &v_bin_elevations,
+    const V &params)
+{
+    estimates e;
+
+    // Get surface indexes
+    e.surface_indexes = state::get_surface_indexes (p, se, w, v_bin_elevations, params);
+
+    // If there is no surface, there is no bathy
+    if (e.surface_indexes.empty ())
+        return e;
+
+    // Compute surface elevation for this window
+    e.surface_elevation = get_mean_elevation (p, e.surface_indexes);
+
+    // Get bathy
+    e.bathy_indexes = state::get_bathy_indexes (p, se, w, v_bin_elevations, params);
+    e.bathy_elevation = get_mean_elevation (p, e.bathy_indexes);
+
+    return e;
+}
+
+/// @brief Classify photons using a track's saved state
+///
+/// Only the threshold-dependent selection and the smoothing stages
+/// are recomputed.
+template<typename T,typename U>
+T classify (T p, const track &t, const U &params)
+{
+    using namespace std;
+
+    if (!is_compatible (t, p, params))
+        throw runtime_error ("The saved state does not match the photons or parameters");
+
+    const auto v_bin_elevations = get_v_bin_elevations (params);
+
+    // Get estimates for each horizontal window
+    vector<estimates> e (t.windows.size ());
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < t.windows.size (); ++i)
+    {
+        // If there are no photons in the h_bin, there is nothing to do
+        if (t.windows[i].indexes.empty ())
+            continue;
+
+        e[i] = state::get_estimates (p, t.se, t.windows[i], v_bin_elevations, params);
+    }
+
+    // Smooth the estimates and assign predictions
+    return assign_estimates (move (p), h_bins_view { t.windows }, e, params);
+}
+
+namespace detail
+{
+
+template<typename T>
+void write (std::ostream &os, const T &x)
+{
+    os.write (reinterpret_cast<const char *> (&x), sizeof (T));
+}
+
+template<typename T>
+void write (std::ostream &os, const std::vector<T> &x)
+{
+    write (os, static_cast<uint64_t> (x.size ()));
+    os.write (reinterpret_cast<const char *> (x.data ()), x.size () * sizeof (T));
+}
+
+template<typename T>
+void read (std::istream &is, T &x)
+{
+    if (!is.read (reinterpret_cast<char *> (&x), sizeof (T)))
+        throw std::runtime_error ("Could not read state");
+}
+
+template<typename T>
+void read (std::istream &is, std::vector<T> &x)
+{
+    uint64_t n;
+    read (is, n);
+
+    // Grow as the data arrives, so that a damaged size runs out of
+    // input instead of allocating it
+    const uint64_t chunk = (uint64_t (1) << 20) / sizeof (T);
+    x.clear ();
+    while (x.size () < n)
+    {
+        const size_t offset = x.size ();
+        const size_t m = std::min (n - offset, chunk);
+        x.resize (offset + m);
+        if (!is.read (reinterpret_cast<char *> (x.data () + offset), m * sizeof (T)))
+            throw std::runtime_error ("Could not read state");
+    }
+}
+
+// Check that a window only refers to photons and bins that exist
+inline bool is_valid (const window &w, const size_t total_bins, const uint64_t total_photons)
+{
+    // Empty windows are not saved
+    if (w.offsets.empty ())
+        return w.indexes.empty () && w.peaks.empty ();
+
+    if (w.offsets.size () != total_bins + 1)
+        return false;
+    if (w.offsets.front () != 0 || w.offsets.back () != w.indexes.size ())
+        return false;
+    for (size_t i = 1; i < w.offsets.size (); ++i)
+        if (w.offsets[i] < w.offsets[i - 1])
+            return false;
+    for (auto i : w.indexes)
+        if (i >= total_photons)
+            return false;
+    for (const auto &i : w.peaks)
+        if (i.bin >= total_bins)
+            return false;
+
+    return true;
+}
+
+} // namespace detail
+
+const std::string MAGIC = std::string ("OOPPSTATE");
+const uint32_t VERSION = 2;
+
+std::ostream &write (std::ostream &os, const track &t)
+{
+    os.write (MAGIC.data (), MAGIC.size ());
+    detail::write (os, VERSION);
+    detail::write (os, t.x_resolution);
+    detail::write (os, t.z_resolution);
+    detail::write (os, t.z_min);
+    detail::write (os, t.z_max);
+    detail::write (os, t.surface_z_min);
+    detail::write (os, t.surface_z_max);
+    detail::write (os, t.vertical_smoothing_sigma);
+    detail::write (os, t.min_peak_prominence);
+    detail::write (os, t.min_peak_distance);
+    detail::write (os, t.total_photons);
+    detail::write (os, t.photons_hash);
+    detail::write (os, t.se.mean);
+    detail::write (os, t.se.variance);
+    detail::write (os, static_cast<uint64_t> (t.windows.size ()));
+    for (const auto &w : t.windows)
+    {
+        detail::write (os, w.indexes);
+        detail::write (os, w.offsets);
+        detail::write (os, w.peaks);
+    }
+    return os;
+}
+
+void write (const std::string &fn, const track &t)
+{
+    std::ofstream ofs (fn, std::ios::binary);
+    if (!ofs)
+        throw std::runtime_error ("Can't open file for writing");
+
+    if (!write (ofs, t))
+        throw std::runtime_error ("Could not write state");
+}
+
+track read (std::istream &is)
+{
+    using namespace std;
+
+    string magic (MAGIC.size (), ' ');
+    if (!is.read (magic.data (), magic.size ()) || magic != MAGIC)
+        throw runtime_error ("Not a state file");
+
+    uint32_t version;
+    detail::read (is, version);
+    if (version != VERSION)
+        throw runtime_error ("Unsupported state file version");
+
+    track t;
+    detail::read (is, t.x_resolution);
+    detail::read (is, t.z_resolution);
+    detail::read (is, t.z_min);
+    detail::read (is, t.z_max);
+    detail::read (is, t.surface_z_min);
+    detail::read (is, t.surface_z_max);
+    detail::read (is, t.vertical_smoothing_sigma);
+    detail::read (is, t.min_peak_prominence);
+    detail::read (is, t.min_peak_distance);
+    detail::read (is, t.total_photons);
+    detail::read (is, t.photons_hash);
+    detail::read (is, t.se.mean);
+    detail::read (is, t.se.variance);
+
+    // The windows are indexed by these bins
+    if (!(t.z_resolution > 0.0) || !(t.z_max > t.z_min)
+        || !((t.z_max - t.z_min) / t.z_resolution < numeric_limits<uint32_t>::max ()))
+        throw runtime_error ("Invalid state file");
+    const size_t total_bins = (t.z_max - t.z_min) / t.z_resolution + 1;
+
+    // A damaged count runs out of input instead of allocating
+    uint64_t n;
+    detail::read (is, n);
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        window w;
+        detail::read (is, w.indexes);
+        detail::read (is, w.offsets);
+        detail::read (is, w.peaks);
+        if (!detail::is_valid (w, total_bins, t.total_photons))
+            throw runtime_error ("Invalid state file");
+        t.windows.push_back (move (w));
+    }
+    return t;
+}
+
+track read (const std::string &fn)
+{
+    std::ifstream ifs (fn, std::ios::binary);
+    if (!ifs)
+        throw std::runtime_error ("Could not open file for reading");
+
+    return read (ifs);
+}
+
+} // namespace state
+
+} // namespace oopp
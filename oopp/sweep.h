@@ -0,0 +1,275 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/oopp.h"
+#include "oopp/scoring.h"
+
+namespace oopp
+{
+
+namespace sweep
+{
+
+// The parameters that determine how photons are binned
+//
+// Parameter sets that share a binning also share their horizontal
+// and vertical bins.
+struct binning
+{
+    double x_resolution;
+    double z_resolution;
+    double z_min;
+    double z_max;
+
+    friend auto operator<=> (const binning &, const binning &) = default;
+};
+
+template<typename T>
+binning get_binning (const T &params)
+{
+    return binning {
+        params.x_resolution,
+        params.z_resolution,
+        params.z_min,
+        params.z_max };
+}
+
+/// @brief Group parameter sets by their binning
+/// @param params Parameter sets
+/// @return Indexes into 'params', grouped by binning
+template<typename T>
+std::map<binning,std::vector<size_t>> group_by_binning (const std::vector<T> &params)
+{
+    std::map<binning,std::vector<size_t>> groups;
+    for (size_t i = 0; i < params.size (); ++i)
+        groups[get_binning (params[i])].push_back (i);
+    return groups;
+}
+
+/// @brief Score many parameter sets against a single track
+/// @param p Labeled photons
+/// @param params Parameter sets
+/// @param classes Classes to score
+/// @param ignore_cls Truth label to ignore, or -1 to not ignore any
+/// @return Confusion matrices for each parameter set
+///
+/// The horizontal and vertical bins are computed once for each
+/// distinct binning, and every parameter set that shares that
+/// binning is evaluated against them. Predictions do not depend on
+/// the smoothed elevation estimates, so each window is scored as soon
+/// as its estimates are available.
+template<typename T,typename U>
+std::vector<scoring::confusion_matrices> sweep_track (const T &p,
+    const std::vector<U> &params,
+    const std::set<long> &classes,
+    const long ignore_cls)
+{
+    using namespace std;
+
+    vector<multiclass_confusion_matrix> cms (params.size (),
+        scoring::get_multiclass_confusion_matrix (classes));
+
+    if (p.empty ())
+        return vector<scoring::confusion_matrices> (params.size (),
+            scoring::get_confusion_matrices (classes));
+
+    for (const auto &i : params)
+        if (has_overlapping_windows (i))
+            throw runtime_error ("Sweeps do not support overlapping windows");
+
+    // Get the global surface estimate for each parameter set
+    vector<surface_estimate> se (params.size ());
+    for (size_t i = 0; i < params.size (); ++i)
+        se[i] = get_surface_estimate (p, params[i]);
+
+    for (const auto &g : group_by_binning (params))
+    {
+        // All parameter sets in the group share these
+        const auto &indexes = g.second;
+        const auto &b = params[indexes[0]];
+        const auto h_bins = get_h_bins (p, b);
+        const auto v_bin_elevations = get_v_bin_elevations (b);
+
+#pragma omp parallel
+        {
+            // Per-thread matrices
+            vector<multiclass_confusion_matrix> local (indexes.size (),
+                scoring::get_multiclass_confusion_matrix (classes));
+
+            // Scratch predictions, reset after each window is scored
+            vector<unsigned> prediction (p.size (), 0);
+
+#pragma omp for schedule(dynamic)
+            for (size_t i = 0; i < h_bins.size (); ++i)
+            {
+                // If there are no photons in the h_bin, there is nothing to do
+                if (h_bins[i].empty ())
+                    continue;
+
+                // Construct vertical distribution once for all parameter sets
+                const auto v_bins = get_v_bins (p, h_bins[i], b);
+
+                for (size_t j = 0; j < indexes.size (); ++j)
+                {
+                    const size_t k = indexes[j];
+                    const auto e = get_estimates (p, se[k], v_bins, v_bin_elevations, params[k]);
+
+                    // Surface first, then bathy, the same as classify()
+                    for (auto n : e.surface_indexes)
+                        prediction[n] = sea_surface_class;
+                    for (auto n : e.bathy_indexes)
+                        prediction[n] = bathy_class;
+
+                    for (auto n : h_bins[i])
+                    {
+                        if (p[n].cls != ignore_cls)
+                            local[j].update (
+                                local[j].get_index (scoring::map_label (p[n].cls)),
+                                local[j].get_index (scoring::map_label (prediction[n])));
+                        prediction[n] = 0;
+                    }
+                }
+            }
+
+#pragma omp critical
+            for (size_t j = 0; j < indexes.size (); ++j)
+                cms[indexes[j]].add (local[j]);
+        }
+
+        // Photons that are not in any window are never assigned a
+        // class. Photons in windows have already been scored, so they
+        // are ignored here.
+        size_t ignored;
+        const auto unbinned = scoring::get_multiclass_confusion_matrix (p.size (),
+            [&](const size_t i) {
+                return (p[i].z <= b.z_max && p[i].z >= b.z_min) ? ignore_cls : static_cast<long> (p[i].cls); },
+            [&](const size_t) { return 0L; },
+            classes,
+            ignore_cls,
+            ignored);
+        for (auto k : indexes)
+            cms[k].add (unbinned);
+    }
+
+    vector<scoring::confusion_matrices> tmp;
+    for (const auto &i : cms)
+        tmp.push_back (scoring::get_confusion_matrices (i));
+
+    return tmp;
+}
+
+/// @brief Score many parameter sets against a range of tracks
+/// @param tracks Tracks
+/// @param first Index of the first track to score
+/// @param last Index one past the last track to score
+/// @return Confusion matrices for each parameter set, summed over the tracks
+///
+/// Tracks are swept concurrently, largest first. Once fewer tracks are
+/// left than threads, each remaining track gets an equal share of the
+/// threads, so a few large tracks still use all of them.
+template<typename T,typename U>
+std::vector<scoring::confusion_matrices> sweep (const std::vector<T> &tracks,
+    const size_t first,
+    const size_t last,
+    const std::vector<U> &params,
+    const std::set<long> &classes,
+    const long ignore_cls)
+{
+    using namespace std;
+
+    assert (first <= last);
+    assert (last <= tracks.size ());
+
+    vector<scoring::confusion_matrices> cms (params.size (),
+        scoring::get_confusion_matrices (classes));
+
+    // Check before the parallel region, which exceptions can't leave
+    for (const auto &i : params)
+        if (has_overlapping_windows (i))
+            throw runtime_error ("Sweeps do not support overlapping windows");
+
+    vector<size_t> order (last - first);
+    iota (order.begin (), order.end (), first);
+    stable_sort (order.begin (), order.end (),
+        [&](const size_t a, const size_t b) { return tracks[a].size () > tracks[b].size (); });
+
+    const size_t threads = omp_get_max_threads ();
+    const int levels = omp_get_max_active_levels ();
+    omp_set_max_active_levels (max (levels, 2));
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t k = 0; k < order.size (); ++k)
+    {
+        const size_t remaining = order.size () - k;
+        omp_set_num_threads (max (size_t (1), threads / min (threads, remaining)));
+        const auto tmp = sweep_track (tracks[order[k]], params, classes, ignore_cls);
+
+#pragma omp critical
+        for (size_t i = 0; i < cms.size (); ++i)
+            scoring::add (cms[i], tmp[i]);
+    }
+
+    omp_set_max_active_levels (levels);
+
+    return cms;
+}
+
+/// @brief Score many parameter sets against many tracks
+/// @return Confusion matrices for each parameter set, summed over all tracks
+template<typename T,typename U>
+std::vector<scoring::confusion_matrices> sweep (const std::vector<T> &tracks,
+    const std::vector<U> &params,
+    const std::set<long> &classes,
+    const long ignore_cls)
+{
+    return sweep (tracks, 0, tracks.size (), params, classes, ignore_cls);
+}
+
+std::string get_params_header ()
+{
+    std::stringstream ss;
+    ss << "x_res"
+        << "\t" << "z_res"
+        << "\t" << "z_min"
+        << "\t" << "z_max"
+        << "\t" << "s_z_min"
+        << "\t" << "s_z_max"
+        << "\t" << "b_min_depth"
+        << "\t" << "v_sigma"
+        << "\t" << "s_sigma"
+        << "\t" << "b_sigma"
+        << "\t" << "prom"
+        << "\t" << "dist"
+        << "\t" << "min_s"
+        << "\t" << "min_b"
+        << "\t" << "s_n_std"
+        << "\t" << "b_n_std";
+    return ss.str ();
+}
+
+template<typename T>
+std::string print_params (const T &params)
+{
+    std::stringstream ss;
+    ss << params.x_resolution
+        << "\t" << params.z_resolution
+        << "\t" << params.z_min
+        << "\t" << params.z_max
+        << "\t" << params.surface_z_min
+        << "\t" << params.surface_z_max
+        << "\t" << params.bathy_min_depth
+        << "\t" << params.vertical_smoothing_sigma
+        << "\t" << params.surface_smoothing_sigma
+        << "\t" << params.bathy_smoothing_sigma
+        << "\t" << params.min_peak_prominence
+        << "\t" << params.min_peak_distance
+        << "\t" << params.min_surface_photons_per_window
+        << "\t" << params.min_bathy_photons_per_window
+        << "\t" << params.surface_n_stddev
+        << "\t" << params.bathy_n_stddev;
+    return ss.str ();
+}
+
+} // namespace sweep
+
+} // namespace oopp
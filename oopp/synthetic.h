@@ -0,0 +1,141 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+#include "oopp/oopp.h"
+
+namespace oopp
+{
+
+namespace synthetic
+{
+
+// Parameters of a synthetic ATL03-like track
+struct track_params
+{
+    double length = 10'000.0; // meters
+    double density = 10.0; // photons per meter
+    double surface_elevation = 0.0; // meters
+    double wave_amplitude = 0.3; // meters
+    double wave_length = 40.0; // meters
+    double surface_stddev = 0.05; // meters
+    double seafloor_depth = 2.0; // meters, at the start of the track
+    double seafloor_slope = 0.002; // meters of depth per meter along-track
+    double seafloor_stddev = 0.2; // meters
+    double bathy_fraction = 0.4; // fraction of returns from the seafloor at zero depth
+    double attenuation = 0.1; // diffuse attenuation coefficient, 1/meters
+    double noise_fraction = 0.1; // fraction of returns that are background noise
+    double noise_z_min = -50.0; // meters
+    double noise_z_max = 30.0; // meters
+    size_t land_gaps = 2; // number of land segments
+    double land_gap_length = 500.0; // meters
+    double land_elevation = 5.0; // meters
+    uint64_t seed = 0;
+};
+
+std::ostream &operator<< (std::ostream &os, const track_params &params)
+{
+    os << "length: " << params.length << "m" << std::endl;
+    os << "density: " << params.density << " photons/m" << std::endl;
+    os << "surface-elevation: " << params.surface_elevation << "m" << std::endl;
+    os << "wave-amplitude: " << params.wave_amplitude << "m" << std::endl;
+    os << "wave-length: " << params.wave_length << "m" << std::endl;
+    os << "seafloor-depth: " << params.seafloor_depth << "m" << std::endl;
+    os << "seafloor-slope: " << params.seafloor_slope << std::endl;
+    os << "bathy-fraction: " << params.bathy_fraction << std::endl;
+    os << "attenuation: " << params.attenuation << "/m" << std::endl;
+    os << "noise-fraction: " << params.noise_fraction << std::endl;
+    os << "land-gaps: " << params.land_gaps << std::endl;
+    os << "land-gap-length: " << params.land_gap_length << "m" << std::endl;
+    os << "seed: " << params.seed << std::endl;
+    return os;
+}
+
+/// @brief Generate a labeled track
+/// @param params Track parameters
+/// @return Photons sorted by along-track distance
+///
+/// Water returns come from a wavy sea surface or a sloping seafloor.
+/// The fraction of seafloor returns decays with the round-trip
+/// attenuation through the water column. Noise is uniform in
+/// elevation. Land segments have ground returns instead of water
+/// returns. Sea surface and bathy photons are labeled as such, and
+/// everything else is labeled unprocessed.
+std::vector<photon> get_track (const track_params &params)
+{
+    using namespace std;
+
+    if (params.length <= 0.0 || params.density <= 0.0)
+        throw runtime_error ("Synthetic track length and density must be positive");
+
+    mt19937_64 rng (params.seed);
+    uniform_real_distribution<> du (0.0, 1.0);
+    uniform_real_distribution<> dn (params.noise_z_min, params.noise_z_max);
+    normal_distribution<> ds (0.0, params.surface_stddev);
+    normal_distribution<> db (0.0, params.seafloor_stddev);
+    normal_distribution<> dl (0.0, 0.3);
+
+    // Place the land segments
+    vector<double> land_starts (params.land_gaps);
+    for (auto &i : land_starts)
+        i = du (rng) * max (0.0, params.length - params.land_gap_length);
+    const auto is_land = [&](const double x)
+    {
+        for (auto i : land_starts)
+            if (x >= i && x < i + params.land_gap_length)
+                return true;
+        return false;
+    };
+
+    const size_t total = params.length * params.density;
+    vector<photon> p (total);
+
+    for (size_t i = 0; i < total; ++i)
+    {
+        auto &q = p[i];
+        q.h5_index = i;
+        // Jitter within each photon's spacing keeps them sorted
+        q.x = (i + du (rng)) / params.density;
+        q.cls = unprocessed_class;
+        q.prediction = unprocessed_class;
+        q.surface_elevation = 0.0;
+        q.bathy_elevation = 0.0;
+
+        const double r = du (rng);
+
+        if (r < params.noise_fraction)
+        {
+            q.z = dn (rng);
+            continue;
+        }
+
+        if (is_land (q.x))
+        {
+            q.z = params.land_elevation
+                + 2.0 * sin (2.0 * M_PI * q.x / 1'000.0)
+                + dl (rng);
+            continue;
+        }
+
+        const double depth = params.seafloor_depth + params.seafloor_slope * q.x;
+        const double bathy_fraction = params.bathy_fraction * exp (-2.0 * params.attenuation * depth);
+
+        if (r < params.noise_fraction + bathy_fraction * (1.0 - params.noise_fraction))
+        {
+            q.z = params.surface_elevation - depth + db (rng);
+            q.cls = bathy_class;
+        }
+        else
+        {
+            q.z = params.surface_elevation
+                + params.wave_amplitude * sin (2.0 * M_PI * q.x / params.wave_length)
+                + ds (rng);
+            q.cls = sea_surface_class;
+        }
+    }
+
+    return p;
+}
+
+} // namespace synthetic
+
+} // namespace oopp
@@ -8,11 +8,12 @@ namespace oopp
 namespace timer
 {
 
+// Times intervals on a monotonic clock
 class timer
 {
 private:
-    std::chrono::time_point<std::chrono::system_clock> t1;
-    std::chrono::time_point<std::chrono::system_clock> t2;
+    std::chrono::time_point<std::chrono::steady_clock> t1;
+    std::chrono::time_point<std::chrono::steady_clock> t2;
     bool running;
 
 public:
@@ -22,19 +23,19 @@ public:
     }
     void start ()
     {
-        t1 = std::chrono::system_clock::now ();
+        t1 = std::chrono::steady_clock::now ();
         running = true;
     }
     void stop ()
     {
-        t2 = std::chrono::system_clock::now ();
+        t2 = std::chrono::steady_clock::now ();
         running = false;
     }
     double elapsed_ns()
     {
         using namespace std::chrono;
         return running
-            ? duration_cast<nanoseconds> (system_clock::now () - t1).count ()
+            ? duration_cast<nanoseconds> (steady_clock::now () - t1).count ()
             : duration_cast<nanoseconds> (t2 - t1).count ();
     }
 };
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "oopp/precompiled.h"
+
+namespace oopp
+{
+
+namespace trace
+{
+
+// A timed span, in nanoseconds since the start of the program
+struct event
+{
+    const char *name;
+    int64_t begin;
+    int64_t end;
+};
+
+namespace detail
+{
+
+// One thread's events
+//
+// Only the owning thread appends to its buffer, so recording an event
+// takes no lock. The registry lock is taken once per thread, the
+// first time that the thread records an event.
+struct buffer
+{
+    int tid;
+    std::vector<event> events;
+};
+
+inline std::mutex registry_mutex;
+inline std::vector<std::shared_ptr<buffer>> registry;
+inline const auto epoch = std::chrono::steady_clock::now ();
+
+inline int64_t now ()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds> (steady_clock::now () - epoch).count ();
+}
+
+inline buffer &get_buffer ()
+{
+    thread_local std::shared_ptr<buffer> b = []
+    {
+        const std::lock_guard<std::mutex> lock (registry_mutex);
+        auto tmp = std::make_shared<buffer> ();
+        tmp->tid = registry.size ();
+        registry.push_back (tmp);
+        return tmp;
+    } ();
+    return *b;
+}
+
+} // namespace detail
+
+// Whether OOPP_TRACE_SPAN records anything in this build
+constexpr bool enabled ()
+{
+#ifdef OOPP_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Records a span from construction to destruction
+class span
+{
+    public:
+    explicit span (const char *name)
+        : n (name)
+        , begin (detail::now ())
+    {
+    }
+    ~span ()
+    {
+        detail::get_buffer ().events.push_back (event { n, begin, detail::now () });
+    }
+    span (const span &) = delete;
+    span &operator= (const span &) = delete;
+
+    private:
+    const char *n;
+    int64_t begin;
+};
+
+/// @brief Write all recorded spans in the Chrome trace event format
+///
+/// The output can be loaded into chrome://tracing or Perfetto. This
+/// must not be called while other threads are recording spans.
+std::ostream &write_chrome_trace (std::ostream &os)
+{
+    using namespace std;
+
+    const lock_guard<mutex> lock (detail::registry_mutex);
+
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto &b : detail::registry)
+    {
+        for (const auto &e : b->events)
+        {
+            os << (first ? "" : ",") << endl;
+            first = false;
+            os << "{\"name\":\"" << e.name << "\""
+                << ",\"ph\":\"X\""
+                << ",\"pid\":0"
+                << ",\"tid\":" << b->tid
+                << fixed << setprecision (3)
+                << ",\"ts\":" << e.begin / 1000.0
+                << ",\"dur\":" << (e.end - e.begin) / 1000.0
+                << "}";
+        }
+    }
+    os << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+    return os;
+}
+
+/// @brief Write all recorded spans to a file
+void write_chrome_trace (const std::string &fn)
+{
+    std::ofstream ofs (fn);
+    if (!ofs)
+        throw std::runtime_error ("Could not open file for writing");
+    write_chrome_trace (ofs);
+}
+
+/// @brief Get the number of recorded spans
+size_t size ()
+{
+    const std::lock_guard<std::mutex> lock (detail::registry_mutex);
+    size_t n = 0;
+    for (const auto &b : detail::registry)
+        n += b->events.size ();
+    return n;
+}
+
+} // namespace trace
+
+} // namespace oopp
+
+// Record a span until the end of the enclosing scope
+//
+// This compiles to nothing unless OOPP_TRACE is defined. The name is
+// not copied, so it should be a string literal.
+#ifdef OOPP_TRACE
+#define OOPP_TRACE_CONCAT_DETAIL(a, b) a##b
+#define OOPP_TRACE_CONCAT(a, b) OOPP_TRACE_CONCAT_DETAIL(a, b)
+#define OOPP_TRACE_SPAN(name) const oopp::trace::span OOPP_TRACE_CONCAT(oopp_trace_span_, __LINE__) (name)
+#else
+#define OOPP_TRACE_SPAN(name) ((void) 0)
+#endif
@@ -0,0 +1,54 @@
+import argparse
+import csv
+import sys
+
+
+def read_results(fn, key_columns):
+    with open(fn) as f:
+        rows = list(csv.DictReader(f, delimiter='\t'))
+    results = {}
+    for r in rows:
+        key = tuple(r[k] for k in key_columns)
+        results[key] = float(r['seconds'])
+    return results
+
+
+def main(args):
+    key_columns = args.key.split(',')
+    baseline = read_results(args.baseline, key_columns)
+    results = read_results(args.results, key_columns)
+
+    failed = False
+    print('\t'.join(key_columns + ['baseline', 'seconds', 'change', 'status']))
+    for key, seconds in results.items():
+        if key not in baseline:
+            print('\t'.join(list(key) + ['', f'{seconds:.4e}', '', 'new']))
+            continue
+        change = 100.0 * (seconds - baseline[key]) / baseline[key]
+        status = 'ok'
+        if change > args.tolerance:
+            status = 'REGRESSED'
+            failed = True
+        print('\t'.join(list(key) + [f'{baseline[key]:.4e}', f'{seconds:.4e}', f'{change:+.1f}%', status]))
+
+    for key in baseline:
+        if key not in results:
+            print('\t'.join(list(key) + [f'{baseline[key]:.4e}', '', '', 'missing']))
+
+    if failed:
+        print(f'Some benchmarks are more than {args.tolerance}% slower than the baseline', file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(
+        description='Compare benchmark timings to a baseline')
+    parser.add_argument('baseline', help='Baseline TSV file')
+    parser.add_argument('results', help='Results TSV file')
+    parser.add_argument('--tolerance', type=float, default=25.0,
+                        help='Allowed slowdown, in percent')
+    parser.add_argument('--key', default='kernel,n',
+                        help='Comma-separated columns that identify a benchmark')
+    args = parser.parse_args()
+    main(args)
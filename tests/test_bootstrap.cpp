@@ -0,0 +1,112 @@
+#include "oopp/precompiled.h"
+#include "oopp/bootstrap.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+mt19937 rng(12345);
+
+vector<multiclass_confusion_matrix> get_random_blocks (const size_t n, const set<long> &classes)
+{
+    const vector<long> labels { 0, 40, 41 };
+    uniform_int_distribution<> d (0, labels.size () - 1);
+    uniform_int_distribution<> e (0, 9);
+    vector<multiclass_confusion_matrix> blocks;
+    for (size_t i = 0; i < n; ++i)
+    {
+        auto m = scoring::get_multiclass_confusion_matrix (classes);
+        for (size_t j = 0; j < 100; ++j)
+        {
+            // Mostly correct predictions
+            const long a = labels[d (rng)];
+            const long p = e (rng) == 0 ? labels[d (rng)] : a;
+            m.update (m.get_index (a), m.get_index (p));
+        }
+        blocks.push_back (m);
+    }
+    return blocks;
+}
+
+void test_percentile ()
+{
+    const vector<double> x { 4.0, 1.0, NAN, 3.0, 2.0, 0.0 };
+    VERIFY (bootstrap::percentile (x, 0.0) == 0.0);
+    VERIFY (bootstrap::percentile (x, 1.0) == 4.0);
+    VERIFY (bootstrap::percentile (x, 0.5) == 2.0);
+    VERIFY (bootstrap::percentile (x, 0.125) == 0.5);
+    VERIFY (isnan (bootstrap::percentile (vector<double> { NAN }, 0.5)));
+}
+
+void test_too_few_blocks ()
+{
+    // A single block would give a zero width interval
+    const auto classes = scoring::get_classes (-1);
+    for (size_t n : { 0, 1 })
+    {
+        bool failed = false;
+        try { bootstrap::get_intervals (get_random_blocks (n, classes), 100, 0.95, 0, true); }
+        catch (...) { failed = true; }
+        VERIFY (failed);
+    }
+}
+
+void test_intervals (const size_t n, const long cls)
+{
+    const auto classes = scoring::get_classes (cls);
+    const auto blocks = get_random_blocks (n, classes);
+    const bool weighted = cls == -1;
+
+    const auto a = bootstrap::get_intervals (blocks, 500, 0.95, 123, weighted);
+    VERIFY (a.size () == classes.size () + weighted);
+
+    for (const auto &r : a)
+    {
+        VERIFY (r.intervals.size () == bootstrap::metric_names.size ());
+        for (const auto &i : r.intervals)
+        {
+            VERIFY (i.lower <= i.upper);
+            VERIFY (i.lower <= i.estimate + 0.01);
+            VERIFY (i.upper >= i.estimate - 0.01);
+        }
+    }
+
+    // The same seed gives the same intervals
+    const auto b = bootstrap::get_intervals (blocks, 500, 0.95, 123, weighted);
+    for (size_t i = 0; i < a.size (); ++i)
+        for (size_t j = 0; j < a[i].intervals.size (); ++j)
+        {
+            VERIFY (a[i].intervals[j].lower == b[i].intervals[j].lower);
+            VERIFY (a[i].intervals[j].upper == b[i].intervals[j].upper);
+        }
+
+    // Identical blocks have no variance
+    const vector<multiclass_confusion_matrix> same (n, blocks[0]);
+    for (const auto &r : bootstrap::get_intervals (same, 100, 0.95, 0, weighted))
+        for (const auto &i : r.intervals)
+            if (!isnan (i.estimate))
+            {
+                VERIFY (abs (i.lower - i.estimate) < 1e-12);
+                VERIFY (abs (i.upper - i.estimate) < 1e-12);
+            }
+}
+
+int main ()
+{
+    try
+    {
+        test_percentile ();
+        test_too_few_blocks ();
+        test_intervals (2, -1);
+        test_intervals (10, -1);
+        test_intervals (100, -1);
+        test_intervals (100, 40);
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
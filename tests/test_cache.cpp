@@ -0,0 +1,217 @@
+#include "oopp/precompiled.h"
+#include "oopp/cache.h"
+#include "oopp/synthetic.h"
+#include "oopp/verify.h"
+
+#include <thread>
+
+using namespace std;
+using namespace oopp;
+
+// Get a synthetic track, with a different seed each time
+vector<photon> get_photons (const size_t total)
+{
+    static uint64_t seed = 0;
+    synthetic::track_params t;
+    t.length = total / t.density;
+    t.land_gaps = 0;
+    t.seed = seed++;
+    return synthetic::get_track (t);
+}
+
+// A cache directory that is removed when it goes out of scope
+struct temp_dir
+{
+    filesystem::path path;
+    temp_dir ()
+        : path (filesystem::temp_directory_path () / ("test_cache_" + to_string (getpid ())))
+    {
+        filesystem::remove_all (path);
+    }
+    ~temp_dir ()
+    {
+        filesystem::remove_all (path);
+    }
+};
+
+size_t count_entries (const filesystem::path &dir)
+{
+    size_t n = 0;
+    for (const auto &i : filesystem::directory_iterator (dir))
+        if (i.path ().extension () == cache::EXTENSION)
+            ++n;
+    return n;
+}
+
+void test_get_key ()
+{
+    const auto p = get_photons (1000);
+    const params a;
+
+    // Keys are reproducible
+    VERIFY (cache::get_key (p, a) == cache::get_key (p, a));
+
+    // Predictions and labels don't change the key
+    auto q = p;
+    q[10].prediction = 41;
+    q[10].cls = 40;
+    VERIFY (cache::get_key (q, a) == cache::get_key (p, a));
+
+    // Inputs do
+    q[10].z += 0.001;
+    VERIFY (cache::get_key (q, a) != cache::get_key (p, a));
+    q.pop_back ();
+    VERIFY (cache::get_key (q, a) != cache::get_key (p, a));
+
+    // And so do parameters
+    params b;
+    b.bathy_n_stddev += 0.5;
+    VERIFY (cache::get_key (p, b) != cache::get_key (p, a));
+    b = a;
+    b.min_bathy_photons_per_window += 1;
+    VERIFY (cache::get_key (p, b) != cache::get_key (p, a));
+}
+
+void test_get_put ()
+{
+    temp_dir dir;
+    cache::cache c (dir.path.string (), 1 << 30);
+
+    const params a;
+    const auto p = classify (get_photons (10'000), a);
+    const auto key = cache::get_key (p, a);
+
+    // Miss
+    auto q = p;
+    for (auto &i : q)
+    {
+        i.prediction = 0;
+        i.surface_elevation = 0.0;
+        i.bathy_elevation = 0.0;
+    }
+    VERIFY (!c.get (key, q));
+    VERIFY (c.hits () == 0);
+    VERIFY (c.misses () == 1);
+
+    // Hit
+    c.put (key, p);
+    VERIFY (c.get (key, q));
+    VERIFY (q == p);
+    VERIFY (c.hits () == 1);
+    VERIFY (c.misses () == 1);
+
+    // Make sure the test is not trivial
+    VERIFY (any_of (p.begin (), p.end (), [](const auto &i) { return i.prediction == bathy_class; }));
+
+    // Another process sees the same entry
+    cache::cache d (dir.path.string (), 1 << 30);
+    VERIFY (d.get (key, q));
+
+    // An entry for a different number of photons is not used
+    auto r = p;
+    r.pop_back ();
+    VERIFY (!d.get (key, r));
+
+    // Neither is a damaged entry
+    filesystem::resize_file (dir.path / (key + cache::EXTENSION), 100);
+    VERIFY (!d.get (key, q));
+}
+
+void test_evict ()
+{
+    temp_dir dir;
+
+    const params a;
+    vector<vector<photon>> p;
+    vector<string> keys;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        p.push_back (classify (get_photons (1000), a));
+        keys.push_back (cache::get_key (p.back (), a));
+    }
+
+    // Room for three entries
+    const auto bytes = 3 * (cache::MAGIC.size () + sizeof (uint32_t) + sizeof (uint64_t) + 1000 * 17);
+    cache::cache c (dir.path.string (), bytes);
+
+    // Timestamps are coarse, so wait between accesses
+    const auto wait = [] { this_thread::sleep_for (chrono::milliseconds (20)); };
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        c.put (keys[i], p[i]);
+        wait ();
+    }
+    VERIFY (count_entries (dir.path) == 3);
+    VERIFY (c.evictions () == 0);
+
+    // Use the oldest entry, so the second one is the least recently used
+    auto q = p[0];
+    VERIFY (c.get (keys[0], q));
+    wait ();
+
+    c.put (keys[3], p[3]);
+    VERIFY (count_entries (dir.path) == 3);
+    VERIFY (c.evictions () == 1);
+    VERIFY (c.get (keys[0], q));
+    wait ();
+    VERIFY (!c.get (keys[1], q));
+    VERIFY (c.get (keys[2], q));
+    VERIFY (c.get (keys[3], q));
+
+    // Opening the directory with less room removes the oldest entry
+    cache::cache d (dir.path.string (), bytes * 2 / 3);
+    VERIFY (count_entries (dir.path) == 2);
+    VERIFY (d.evictions () == 1);
+    VERIFY (!d.get (keys[0], q));
+    VERIFY (d.get (keys[3], q));
+}
+
+void test_temporary_files ()
+{
+    temp_dir dir;
+    filesystem::create_directories (dir.path);
+
+    // One was left behind long ago, and one is still being written
+    const auto stale = dir.path / ("0" + cache::EXTENSION + cache::TEMPORARY + "1.0");
+    const auto fresh = dir.path / ("1" + cache::EXTENSION + cache::TEMPORARY + "1.0");
+    ofstream (stale) << "x";
+    ofstream (fresh) << "x";
+    filesystem::last_write_time (stale, filesystem::file_time_type::clock::now () - chrono::hours (2));
+
+    cache::cache c (dir.path.string (), 1 << 30);
+    VERIFY (!filesystem::exists (stale));
+    VERIFY (filesystem::exists (fresh));
+
+    // A failed rename leaves no temporary file behind
+    const params a;
+    const auto p = classify (get_photons (1000), a);
+    const auto key = cache::get_key (p, a);
+    filesystem::create_directories (dir.path / (key + cache::EXTENSION) / "x");
+    bool failed = false;
+    try { c.put (key, p); }
+    catch (const exception &e) { failed = string (e.what ()) == "Could not write cache entry"; }
+    VERIFY (failed);
+    size_t n = 0;
+    for (const auto &i : filesystem::directory_iterator (dir.path))
+        n += i.path ().filename ().string ().find (cache::TEMPORARY) != string::npos;
+    VERIFY (n == 1);
+}
+
+int main ()
+{
+    try
+    {
+        test_get_key ();
+        test_get_put ();
+        test_evict ();
+        test_temporary_files ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -1,5 +1,6 @@
 #include "oopp/precompiled.h"
 #include "oopp/dataframe.h"
+#include "oopp/synthetic.h"
 #include "oopp/verify.h"
 
 using namespace std;
@@ -74,12 +75,85 @@ void test_empty_classify ()
     VERIFY (q.size () == total);
 }
 
+void test_classify_batch ()
+{
+    mt19937 rng(12345);
+    uniform_real_distribution<double> dz (-60.0, 20.0);
+    normal_distribution<double> ds (0.0, 0.1);
+
+    // Tracks of different lengths, including an empty one
+    vector<vector<photon>> tracks;
+    for (auto total : { 500, 0, 10, 5000, 1 })
+    {
+        uniform_real_distribution<double> dx (0, total);
+        vector<photon> p (total);
+        size_t index = 0;
+        for (auto &i : p)
+        {
+            i.h5_index = index;
+            i.x = dx (rng);
+            i.z = (index++ % 2) ? ds (rng) : dz (rng);
+        }
+        tracks.push_back (p);
+    }
+
+    // It should give the same answer as classifying one at a time
+    oopp::params oo_params;
+    const auto q = classify_batch (tracks, oo_params);
+    VERIFY (q.size () == tracks.size ());
+    for (size_t i = 0; i < tracks.size (); ++i)
+    {
+        if (tracks[i].empty ())
+            VERIFY (q[i].empty ());
+        else
+            VERIFY (q[i] == classify (tracks[i], oo_params));
+    }
+
+    // Nothing to do
+    VERIFY (classify_batch (vector<vector<photon>> (), oo_params).empty ());
+}
+
+void test_classify_profile ()
+{
+    synthetic::track_params tp;
+    tp.length = 2'000.0;
+    const auto p = synthetic::get_track (tp);
+
+    for (auto x_stride : { 0.0, 5.0 })
+    {
+        params params;
+        params.x_stride = x_stride;
+
+        // Profiling doesn't change the results
+        profile::profiler prof;
+        VERIFY (classify (p, params, prof) == classify (p, params));
+
+        const vector<string> expected {
+            "surface_estimate",
+            "h_binning",
+            "window_loop",
+            "surface_smoothing",
+            "bathy_smoothing",
+            "assignment" };
+        const auto &stages = prof.get_stages ();
+        VERIFY (stages.size () == expected.size ());
+        for (size_t i = 0; i < stages.size (); ++i)
+        {
+            VERIFY (stages[i].name == expected[i]);
+            VERIFY (stages[i].photons == p.size ());
+            VERIFY (stages[i].seconds >= 0.0);
+        }
+    }
+}
+
 int main ()
 {
     try
     {
         test_classify ();
         test_empty_classify ();
+        test_classify_batch ();
+        test_classify_profile ();
 
         return 0;
     }
@@ -0,0 +1,121 @@
+#include "oopp/precompiled.h"
+#include "oopp/oopp.h"
+#include "oopp/scoring.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+mt19937 rng(12345);
+
+vector<photon> get_random_labels (const size_t total)
+{
+    const vector<unsigned> labels { 0, 1, 40, 41, 45, 300 };
+    uniform_int_distribution<> d (0, labels.size () - 1);
+    vector<photon> p (total);
+    for (auto &i : p)
+    {
+        i.cls = labels[d (rng)];
+        i.prediction = labels[d (rng)];
+    }
+    return p;
+}
+
+void test_multiclass (const size_t n, const long cls, const long ignore_cls)
+{
+    const auto p = get_random_labels (n);
+    const auto classes = scoring::get_classes (cls);
+
+    size_t ignored = 0;
+    const auto m = scoring::get_multiclass_confusion_matrix (p, classes, ignore_cls, ignored);
+    VERIFY (m.size () == classes.size () + 1);
+    VERIFY (m.total () + ignored == n);
+
+    // Compare to one-vs-rest matrices computed one class at a time
+    for (auto c : classes)
+    {
+        confusion_matrix expected;
+        for (const auto &i : p)
+        {
+            if (static_cast<long> (i.cls) == ignore_cls)
+                continue;
+            const long actual = scoring::map_label (i.cls);
+            const long pred = scoring::map_label (i.prediction);
+            expected.update (actual == c, pred == c);
+        }
+
+        const auto cm = m.get_confusion_matrix (c);
+        VERIFY (cm.true_positives () == expected.true_positives ());
+        VERIFY (cm.true_negatives () == expected.true_negatives ());
+        VERIFY (cm.false_positives () == expected.false_positives ());
+        VERIFY (cm.false_negatives () == expected.false_negatives ());
+    }
+
+    // Adding is the same as scoring both sets at once
+    auto twice (m);
+    twice.add (m);
+    VERIFY (twice.total () == 2 * m.total ());
+    const auto a = twice.get_confusion_matrix (*classes.begin ());
+    const auto b = m.get_confusion_matrix (*classes.begin ());
+    VERIFY (a.true_positives () == 2 * b.true_positives ());
+}
+
+void test_exact_counts ()
+{
+    // Doubles can't represent this plus one
+    const uint64_t big = (uint64_t (1) << 53) + 1;
+    confusion_matrix a (big, big, big, big);
+    a.update (true, true);
+    a.add (confusion_matrix (1, 0, 0, 0));
+    VERIFY (a.true_positives () == big + 2);
+    VERIFY (a.true_negatives () == big);
+    VERIFY (a.total () == 4 * big + 2);
+    VERIFY (a.support () == 2 * big + 2);
+
+    // Metrics are still well defined
+    VERIFY (a.accuracy () > 0.49 && a.accuracy () < 0.51);
+    VERIFY (a.MCC () > -0.01 && a.MCC () < 0.01);
+}
+
+void test_reduction (const size_t n, const long cls)
+{
+    const auto p = get_random_labels (n);
+    const auto classes = scoring::get_classes (cls);
+
+    size_t ignored = 0;
+    const auto expected = scoring::get_multiclass_confusion_matrix (p, classes, -1, ignored);
+
+    // Merge one matrix per photon
+    auto m = scoring::get_multiclass_confusion_matrix (classes);
+#pragma omp parallel for reduction(+:m)
+    for (size_t i = 0; i < p.size (); ++i)
+        m.update (m.get_index (scoring::map_label (p[i].cls)), m.get_index (scoring::map_label (p[i].prediction)));
+
+    VERIFY (m.total () == n);
+    for (size_t i = 0; i < m.size (); ++i)
+        for (size_t j = 0; j < m.size (); ++j)
+            VERIFY (m.count (i, j) == expected.count (i, j));
+}
+
+int main ()
+{
+    try
+    {
+        test_multiclass (0, -1, -1);
+        test_multiclass (10, -1, -1);
+        test_multiclass (100'000, -1, -1);
+        test_multiclass (100'000, 40, 41);
+        test_multiclass (100'000, 300, -1);
+        test_exact_counts ();
+        test_reduction (0, -1);
+        test_reduction (100'000, -1);
+        test_reduction (100'000, 40);
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
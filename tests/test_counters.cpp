@@ -0,0 +1,57 @@
+#include "oopp/precompiled.h"
+#include "oopp/counters.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+void test_counters ()
+{
+    counters::counter_set c;
+
+    // Counters may not be available here, but that is not an error
+    VERIFY (c.available () || !c.get_error ().empty ());
+
+    c.start ();
+    volatile double x = 0.0;
+    for (size_t i = 0; i < 1'000'000; ++i)
+        x = x + sqrt (static_cast<double> (i));
+    const auto v = c.stop ();
+
+    for (size_t i = 0; i < counters::event_count; ++i)
+        VERIFY (isnan (v[i]) || v[i] >= 0.0);
+
+    if (!isnan (v[counters::instructions]))
+        VERIFY (v[counters::instructions] >= 1'000'000);
+
+    // Stopped counters don't count
+    const auto w = c.stop ();
+    for (size_t i = 0; i < counters::event_count; ++i)
+        VERIFY ((isnan (v[i]) && isnan (w[i])) || w[i] == v[i]);
+}
+
+void test_unavailable ()
+{
+    counters::values v;
+    v.fill (numeric_limits<double>::quiet_NaN ());
+    VERIFY (isnan (counters::IPC (v)));
+    v[counters::cycles] = 100.0;
+    v[counters::instructions] = 250.0;
+    VERIFY (counters::IPC (v) == 2.5);
+}
+
+int main ()
+{
+    try
+    {
+        test_counters ();
+        test_unavailable ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -43,6 +43,43 @@ void test_dataframe (const size_t cols, const size_t rows)
     VERIFY (df == tmp);
 }
 
+void test_read_columns (const size_t cols, const size_t rows, const size_t chunk_size)
+{
+    const auto df = get_random_dataframe (cols, rows);
+    const auto headers = df.get_headers ();
+
+    stringstream ss;
+    write (ss, df);
+
+    // Read the last column, a missing column, and the first column
+    const vector<string> names { headers.back (), "missing", headers.front () };
+    vector<vector<double>> values (names.size ());
+    size_t chunks = 0;
+    const auto found = read_columns (ss, names, [&](const auto &v)
+    {
+        VERIFY (v.size () == names.size ());
+        VERIFY (v[0].size () <= chunk_size);
+        for (size_t i = 0; i < v.size (); ++i)
+            values[i].insert (values[i].end (), v[i].begin (), v[i].end ());
+        ++chunks;
+    }, chunk_size);
+
+    VERIFY (found[0]);
+    VERIFY (!found[1]);
+    VERIFY (found[2]);
+    VERIFY (chunks == (rows + chunk_size - 1) / chunk_size);
+
+    for (size_t i = 0; i < values.size (); ++i)
+        VERIFY (values[i].size () == rows);
+
+    for (size_t i = 0; i < rows; ++i)
+    {
+        VERIFY (values[0][i] == df.get_value (headers.back (), i));
+        VERIFY (values[1][i] == 0.0);
+        VERIFY (values[2][i] == df.get_value (headers.front (), i));
+    }
+}
+
 int main ()
 {
     try
@@ -52,6 +89,11 @@ int main ()
         test_dataframe (1, 23);
         test_dataframe (19, 111);
         test_dataframe (32, 20'000);
+        test_read_columns (2, 1, 1);
+        test_read_columns (7, 100, 1);
+        test_read_columns (7, 100, 33);
+        test_read_columns (19, 10'000, 1'000);
+        test_read_columns (19, 10'001, 1'000);
 
         return 0;
     }
@@ -0,0 +1,114 @@
+// Count allocations in this test
+#define OOPP_COUNT_ALLOCATIONS
+
+#include "oopp/precompiled.h"
+#include "oopp/memory.h"
+#include "oopp/profile.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+void test_rss ()
+{
+#ifdef __linux__
+    VERIFY (memory::get_rss () > 0);
+    VERIFY (memory::get_peak_rss () > 0);
+#endif
+
+    // Touch the pages of a large buffer
+    const size_t n = 64 << 20;
+    vector<char> x (n, 1);
+    VERIFY (accumulate (x.begin (), x.end (), size_t (0)) == n);
+
+#ifdef __linux__
+    VERIFY (memory::get_peak_rss () >= n);
+    VERIFY (memory::get_peak_rss () >= memory::get_rss ());
+#endif
+}
+
+void test_live_bytes ()
+{
+    profile::count_allocations (true);
+
+    const auto a = profile::get_allocation_counts ();
+    {
+        vector<char> x (1'000);
+        const auto b = profile::get_allocation_counts ();
+        VERIFY (b.allocations == a.allocations + 1);
+        VERIFY (b.bytes == a.bytes + 1'000);
+        VERIFY (b.live == a.live + 1'000);
+    }
+    const auto c = profile::get_allocation_counts ();
+    VERIFY (c.live == a.live);
+
+    profile::count_allocations (false);
+
+    // Memory allocated while counting is off doesn't count when freed
+    auto y = make_unique<vector<char>> (1'000);
+    profile::count_allocations (true);
+    y.reset ();
+    VERIFY (profile::get_allocation_counts ().live == a.live);
+    profile::count_allocations (false);
+}
+
+void test_peaks ()
+{
+    profile::count_allocations (true);
+
+    const size_t n = 8 << 20;
+    profile::profiler prof;
+    prof.run ("outer", 0, [&]
+    {
+        // The inner peak is above the outer one
+        prof.run ("inner", 0, [&]
+        {
+            vector<char> x (2 * n);
+        });
+        vector<char> x (n);
+    });
+
+    profile::count_allocations (false);
+
+    const auto &stages = prof.get_stages ();
+    VERIFY (stages.size () == 2);
+    VERIFY (stages[0].name == "inner");
+    VERIFY (stages[1].name == "outer");
+    VERIFY (stages[0].peak_heap_bytes >= 2 * n);
+    VERIFY (stages[0].peak_heap_bytes < 3 * n);
+
+    // The outer peak includes the inner one
+    VERIFY (stages[1].peak_heap_bytes >= stages[0].peak_heap_bytes);
+    VERIFY (stages[1].peak_rss_bytes >= stages[0].peak_rss_bytes);
+    VERIFY (stages[1].allocations > stages[0].allocations);
+}
+
+void test_no_sampling ()
+{
+    // Memory isn't sampled while allocations aren't counted
+    profile::profiler prof;
+    prof.run ("stage", 0, [] { });
+    const auto &s = prof.get_stages ().back ();
+    VERIFY (s.allocations == 0);
+    VERIFY (s.peak_heap_bytes == 0);
+    VERIFY (s.rss_bytes == 0);
+    VERIFY (s.peak_rss_bytes == 0);
+}
+
+int main ()
+{
+    try
+    {
+        test_rss ();
+        test_live_bytes ();
+        test_peaks ();
+        test_no_sampling ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -1,5 +1,6 @@
 #include "oopp/precompiled.h"
 #include "oopp/oopp.h"
+#include "oopp/synthetic.h"
 #include "oopp/verify.h"
 
 using namespace std;
@@ -117,6 +118,102 @@ void test_classify (size_t n)
     }
 }
 
+// Returns the number of surface and bathy photons selected
+pair<size_t,size_t> test_sliding_estimates (const vector<photon> &p, const double x_stride)
+{
+    params a;
+    a.x_stride = x_stride;
+    VERIFY (has_overlapping_windows (a));
+
+    const auto se = get_surface_estimate (p, a);
+    auto b (a);
+    b.x_resolution = a.x_stride;
+    const auto cells = get_h_bins (p, b);
+    const auto e = get_sliding_estimates (p, se, cells, a);
+    VERIFY (e.size () == cells.size ());
+
+    // Compare to windows that are built from scratch
+    const double x_min = min_element (p.begin (), p.end (),
+            [](const auto &i, const auto &j) { return i.x < j.x; })->x;
+    const auto v_bin_elevations = get_v_bin_elevations (a);
+    size_t total = 0;
+    size_t total_bathy = 0;
+    for (size_t c = 0; c < cells.size (); ++c)
+    {
+        if (cells[c].empty ())
+            continue;
+
+        // Get the window's photons in along-track order
+        const double x0 = x_min + (c + 0.5) * a.x_stride - a.x_resolution / 2.0;
+        const double x1 = x_min + (c + 0.5) * a.x_stride + a.x_resolution / 2.0;
+        vector<size_t> w;
+        for (size_t i = 0; i < p.size (); ++i)
+            if (p[i].x >= x0 && p[i].x < x1 && p[i].z <= a.z_max && p[i].z >= a.z_min)
+                w.push_back (i);
+        stable_sort (w.begin (), w.end (),
+            [&](const auto i, const auto j) { return p[i].x < p[j].x; });
+
+        const auto v_bins = get_v_bins (p, w, a);
+        auto f = get_estimates (p, se, v_bins, v_bin_elevations, a);
+
+        // Only the photons in the cell get classified
+        set<size_t> cell (cells[c].begin (), cells[c].end ());
+        erase_if (f.surface_indexes, [&](const size_t i) { return !cell.contains (i); });
+        erase_if (f.bathy_indexes, [&](const size_t i) { return !cell.contains (i); });
+
+        // Elevations are computed from sums over bins, so they can
+        // differ in the last bits
+        VERIFY (fabs (e[c].surface_elevation - f.surface_elevation) < 1e-9);
+        VERIFY (fabs (e[c].bathy_elevation - f.bathy_elevation) < 1e-9);
+
+        // The same photons are selected, although in a different order
+        auto si = e[c].surface_indexes;
+        auto bi = e[c].bathy_indexes;
+        sort (si.begin (), si.end ());
+        sort (bi.begin (), bi.end ());
+        sort (f.surface_indexes.begin (), f.surface_indexes.end ());
+        sort (f.bathy_indexes.begin (), f.bathy_indexes.end ());
+        VERIFY (si == f.surface_indexes);
+        VERIFY (bi == f.bathy_indexes);
+        total += si.size ();
+        total_bathy += bi.size ();
+    }
+
+    // Classification should be deterministic
+    const auto q = classify (p, a);
+    VERIFY (q == classify (p, a));
+
+    return { total, total_bathy };
+}
+
+void test_sliding_estimates (size_t n, const double x_stride)
+{
+    auto p = get_random_photons (n);
+
+    // Add a surface
+    normal_distribution<> ds (0.0, 0.1);
+    for (size_t i = 0; i < p.size (); i += 2)
+        p[i].z = ds (rng);
+
+    const auto total = test_sliding_estimates (p, x_stride);
+
+    // Make sure the test is not trivial
+    if (n > 1000)
+        VERIFY (total.first != 0);
+}
+
+void test_sliding_estimates_with_bathy (const double x_stride)
+{
+    synthetic::track_params tp;
+    tp.length = 2'000.0;
+    tp.seed = 1;
+    const auto total = test_sliding_estimates (synthetic::get_track (tp), x_stride);
+
+    // Make sure the test is not trivial
+    VERIFY (total.first != 0);
+    VERIFY (total.second != 0);
+}
+
 int main ()
 {
     try
@@ -125,6 +222,12 @@ int main ()
         test_get_v_bins ();
         test_classify (10);
         test_classify (10'000);
+        test_sliding_estimates (10, 2.5);
+        test_sliding_estimates (10'000, 2.5);
+        test_sliding_estimates (10'000, 3.0);
+        test_sliding_estimates (10'000, 7.0);
+        test_sliding_estimates_with_bathy (2.5);
+        test_sliding_estimates_with_bathy (1.0);
 
         return 0;
     }
@@ -0,0 +1,101 @@
+#include "oopp/precompiled.h"
+#include "oopp/residuals.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+mt19937 rng(12345);
+
+void test_stats (const size_t n)
+{
+    // Residuals of labeled samples
+    normal_distribution<double> d (0.1, 0.5);
+    uniform_int_distribution<> e (0, 1);
+    vector<long> labels (n);
+    vector<double> estimates (n);
+    vector<double> reference (n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        labels[i] = e (rng) ? 41 : 40;
+        reference[i] = d (rng);
+        estimates[i] = i % 100 == 0 ? NAN : 2.0 * reference[i];
+    }
+
+    const auto s = residuals::get_stats (n,
+        [&](const size_t i) { return labels[i]; },
+        [&](const size_t i) { return estimates[i]; },
+        [&](const size_t i) { return reference[i]; },
+        41);
+
+    // Compare to brute force
+    vector<double> r;
+    for (size_t i = 0; i < n; ++i)
+        if (labels[i] == 41 && !isnan (estimates[i]))
+            r.push_back (estimates[i] - reference[i]);
+
+    VERIFY (s.count () == r.size ());
+
+    if (r.empty ())
+        return;
+
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    double sum_abs = 0.0;
+    for (auto x : r)
+    {
+        sum += x;
+        sum_sq += x * x;
+        sum_abs += fabs (x);
+    }
+    VERIFY (fabs (s.bias () - sum / r.size ()) < 1e-9);
+    VERIFY (fabs (s.RMSE () - sqrt (sum_sq / r.size ())) < 1e-9);
+    VERIFY (fabs (s.MAE () - sum_abs / r.size ()) < 1e-9);
+
+    // Percentiles are accurate to within a bin
+    sort (r.begin (), r.end ());
+    for (auto p : { 0.0, 0.05, 0.5, 0.95, 1.0 })
+    {
+        const double expected = r[min (r.size () - 1, static_cast<size_t> (p * r.size ()))];
+        VERIFY (fabs (s.percentile (p) - expected) <= s.bin_width ());
+    }
+
+    // Merging is the same as accumulating both at once
+    auto twice (s);
+    twice.add (s);
+    VERIFY (twice.count () == 2 * s.count ());
+    VERIFY (fabs (twice.bias () - s.bias ()) < 1e-9);
+    VERIFY (twice.percentile (0.5) == s.percentile (0.5));
+}
+
+void test_clamp ()
+{
+    residuals::stats s (0.1, 1.0);
+    s.update (-100.0);
+    s.update (0.0);
+    s.update (100.0);
+    VERIFY (s.count () == 3);
+    VERIFY (s.percentile (0.0) == -1.0);
+    VERIFY (s.percentile (0.5) == 0.0);
+    VERIFY (s.percentile (1.0) == 1.0);
+    VERIFY (s.MAE () > 66.0);
+}
+
+int main ()
+{
+    try
+    {
+        test_stats (0);
+        test_stats (1);
+        test_stats (1'000);
+        test_stats (100'000);
+        test_clamp ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
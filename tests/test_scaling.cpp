@@ -0,0 +1,67 @@
+#include "oopp/precompiled.h"
+#include "oopp/scaling.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+bool about_equal (const double a, const double b)
+{
+    return fabs (a - b) < 1e-9;
+}
+
+void test_metrics ()
+{
+    // Perfect scaling
+    VERIFY (about_equal (scaling::speedup (8.0, 1.0), 8.0));
+    VERIFY (about_equal (scaling::efficiency (8.0, 8), 1.0));
+    VERIFY (about_equal (scaling::serial_fraction (8.0, 8), 0.0));
+
+    // No scaling
+    VERIFY (about_equal (scaling::serial_fraction (1.0, 8), 1.0));
+
+    // Amdahl's law with a serial fraction of 0.1
+    for (size_t p : { 2, 4, 16, 128 })
+    {
+        const double f = 0.1;
+        const double s = 1.0 / (f + (1.0 - f) / p);
+        VERIFY (about_equal (scaling::serial_fraction (s, p), f));
+        VERIFY (scaling::efficiency (s, p) < 1.0);
+    }
+
+    // Undefined on one thread
+    VERIFY (isnan (scaling::serial_fraction (1.0, 1)));
+}
+
+void test_thread_counts ()
+{
+    VERIFY (scaling::get_thread_counts (1) == vector<size_t> ({ 1 }));
+    VERIFY (scaling::get_thread_counts (8) == vector<size_t> ({ 1, 2, 4, 8 }));
+    VERIFY (scaling::get_thread_counts (24) == vector<size_t> ({ 1, 2, 4, 8, 16, 24 }));
+}
+
+void test_splits ()
+{
+    VERIFY (scaling::get_splits (1) == vector<size_t> ({ 1 }));
+    VERIFY (scaling::get_splits (12) == vector<size_t> ({ 1, 2, 3, 4, 6, 12 }));
+    for (size_t cores = 1; cores <= 128; ++cores)
+        for (auto p : scaling::get_splits (cores))
+            VERIFY (cores % p == 0);
+}
+
+int main ()
+{
+    try
+    {
+        test_metrics ();
+        test_thread_counts ();
+        test_splits ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
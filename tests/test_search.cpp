@@ -0,0 +1,289 @@
+#include "oopp/precompiled.h"
+#include "oopp/search.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+search::dimension get_n_stddev (const string &spec)
+{
+    return search::get_dimension ("n-stddev", spec, [](auto &a, double x) { a.surface_n_stddev = x; }, false);
+}
+
+search::dimension get_min_photons (const string &spec)
+{
+    return search::get_dimension ("min-photons", spec, [](auto &a, double x) { a.min_bathy_photons_per_window = x; }, true);
+}
+
+void test_get_dimension ()
+{
+    // List
+    {
+        const auto d = get_n_stddev ("1,2.5,3");
+        VERIFY (d.values == vector<double> ({ 1.0, 2.5, 3.0 }));
+    }
+
+    // Range
+    {
+        const auto d = get_n_stddev ("2:4");
+        VERIFY (d.values.empty ());
+        VERIFY (d.min == 2.0);
+        VERIFY (d.max == 4.0);
+        VERIFY (d.points == 0);
+    }
+
+    // Range with grid points
+    {
+        const auto d = get_n_stddev ("2:4:3");
+        VERIFY (d.points == 3);
+    }
+
+    // Integer ranges shrink to the integers inside them
+    {
+        const auto d = get_min_photons ("1.5:4.5");
+        VERIFY (d.min == 2.0);
+        VERIFY (d.max == 4.0);
+    }
+
+    // Errors
+    for (auto spec : { "", "2:", ":4", "4:2", "2:4:0", "2:4:5:6", "1,,2" })
+    {
+        bool failed = false;
+        try { get_n_stddev (spec); }
+        catch (...) { failed = true; }
+        VERIFY (failed);
+    }
+    bool failed = false;
+    try { get_min_photons ("2.2:2.8"); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_get_grid ()
+{
+    VERIFY (search::get_grid_values (get_n_stddev ("2:4"), 5) == vector<double> ({ 2.0, 2.5, 3.0, 3.5, 4.0 }));
+    VERIFY (search::get_grid_values (get_n_stddev ("2:4:3"), 5) == vector<double> ({ 2.0, 3.0, 4.0 }));
+    VERIFY (search::get_grid_values (get_n_stddev ("2:4:1"), 5) == vector<double> ({ 2.0 }));
+    VERIFY (search::get_grid_values (get_min_photons ("2:8"), 5) == vector<double> ({ 2, 3, 4, 5, 6, 7, 8 }));
+    VERIFY (search::get_grid_values (get_min_photons ("2:4:5"), 5) == vector<double> ({ 2, 3, 4 }));
+
+    // No dimensions
+    const params base;
+    VERIFY (search::get_grid (base, {}, 5).size () == 1);
+
+    // The last dimension varies fastest
+    const auto p = search::get_grid (base, { get_n_stddev ("1,2"), get_min_photons ("3:5") }, 5);
+    VERIFY (p.size () == 6);
+    VERIFY (p[0].surface_n_stddev == 1.0);
+    VERIFY (p[0].min_bathy_photons_per_window == 3);
+    VERIFY (p[1].surface_n_stddev == 1.0);
+    VERIFY (p[1].min_bathy_photons_per_window == 4);
+    VERIFY (p[5].surface_n_stddev == 2.0);
+    VERIFY (p[5].min_bathy_photons_per_window == 5);
+
+    // Parameters that are not searched are unchanged
+    for (const auto &i : p)
+        VERIFY (i.bathy_n_stddev == base.bathy_n_stddev);
+}
+
+void test_get_value ()
+{
+    const auto a = get_n_stddev ("1,2,3");
+    VERIFY (search::get_value (a, 0.0) == 1.0);
+    VERIFY (search::get_value (a, 0.5) == 2.0);
+    VERIFY (search::get_value (a, nextafter (1.0, 0.0)) == 3.0);
+
+    const auto b = get_n_stddev ("2:4");
+    VERIFY (search::get_value (b, 0.0) == 2.0);
+    VERIFY (search::get_value (b, 0.25) == 2.5);
+
+    // Each integer gets an equal share
+    const auto c = get_min_photons ("2:5");
+    VERIFY (search::get_value (c, 0.0) == 2.0);
+    VERIFY (search::get_value (c, 0.24) == 2.0);
+    VERIFY (search::get_value (c, 0.26) == 3.0);
+    VERIFY (search::get_value (c, nextafter (1.0, 0.0)) == 5.0);
+}
+
+void test_samples ()
+{
+    const params base;
+    const vector<search::dimension> dims { get_n_stddev ("2:4"), get_min_photons ("2:8") };
+
+    for (auto n : { 1, 7, 100 })
+    {
+        const auto r = search::get_random (base, dims, n, 123);
+        const auto l = search::get_latin_hypercube (base, dims, n, 123);
+        VERIFY (r.size () == size_t (n));
+        VERIFY (l.size () == size_t (n));
+
+        for (const auto &p : { r, l })
+        {
+            for (const auto &i : p)
+            {
+                VERIFY (i.surface_n_stddev >= 2.0 && i.surface_n_stddev <= 4.0);
+                VERIFY (i.min_bathy_photons_per_window >= 2 && i.min_bathy_photons_per_window <= 8);
+                VERIFY (i.bathy_n_stddev == base.bathy_n_stddev);
+            }
+        }
+
+        // Each stratum of a Latin hypercube is sampled once
+        vector<size_t> strata (n);
+        for (const auto &i : l)
+            ++strata[min (size_t (n - 1), static_cast<size_t> ((i.surface_n_stddev - 2.0) / 2.0 * n))];
+        for (auto i : strata)
+            VERIFY (i == 1);
+    }
+
+    // Samples are reproducible
+    const auto a = search::get_latin_hypercube (base, dims, 10, 1);
+    const auto b = search::get_latin_hypercube (base, dims, 10, 1);
+    const auto c = search::get_latin_hypercube (base, dims, 10, 2);
+    bool same = true;
+    bool different = false;
+    for (size_t i = 0; i < a.size (); ++i)
+    {
+        same = same && a[i].surface_n_stddev == b[i].surface_n_stddev;
+        different = different || a[i].surface_n_stddev != c[i].surface_n_stddev;
+    }
+    VERIFY (same);
+    VERIFY (different);
+}
+
+void test_scores ()
+{
+    scoring::confusion_matrices cms;
+    cms[40] = confusion_matrix (10, 80, 5, 5);
+    cms[41] = confusion_matrix (0, 90, 0, 10);
+
+    const auto s = search::get_scores (cms, 40);
+    VERIFY (search::get_score (s, "acc") == cms[40].accuracy ());
+    VERIFY (search::get_score (s, "F1") == cms[40].F1 ());
+    VERIFY (search::get_score (s, "MCC") == cms[40].MCC ());
+    VERIFY (fabs (search::get_score (s, "Avg")
+        - (s.F1 + s.bal_acc + s.cal_F1 + s.MCC) / 4.0) < 1e-12);
+
+    const auto w = search::get_scores (cms, -1);
+    VERIFY (search::get_score (w, "F1") == scoring::get_weighted_scores (cms).F1);
+
+    bool failed = false;
+    try { search::get_scores (cms, 0); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+
+    failed = false;
+    try { search::get_score (s, "AUC"); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_get_ranking ()
+{
+    const vector<double> s { 0.5, NAN, 0.9, 0.5, 0.1 };
+    VERIFY (search::get_ranking (s) == vector<size_t> ({ 2, 0, 3, 4, 1 }));
+    VERIFY (search::get_ranking ({}).empty ());
+}
+
+void test_get_rungs ()
+{
+    const auto r = search::get_rungs (100, 180, 4, 3.0);
+    VERIFY (r.size () == 5);
+    VERIFY (r[0].configs == 100 && r[0].files == 4);
+    VERIFY (r[1].configs == 34 && r[1].files == 12);
+    VERIFY (r[2].configs == 12 && r[2].files == 36);
+    VERIFY (r[3].configs == 4 && r[3].files == 108);
+    VERIFY (r[4].configs == 2 && r[4].files == 180);
+
+    // A single configuration goes straight to all of the files
+    const auto a = search::get_rungs (9, 1000, 1, 3.0);
+    VERIFY (a.size () == 3);
+    VERIFY (a[2].configs == 1 && a[2].files == 1000);
+
+    // Each rung adds a file
+    const auto b = search::get_rungs (1000, 5, 1, 1.1);
+    for (size_t i = 1; i < b.size (); ++i)
+        VERIFY (b[i].files > b[i - 1].files);
+    VERIFY (b.back ().files == 5);
+
+    // More files in the first rung than there are
+    const auto c = search::get_rungs (10, 3, 8, 2.0);
+    VERIFY (c.size () == 1);
+    VERIFY (c[0].configs == 10 && c[0].files == 3);
+
+    VERIFY (search::get_rungs (0, 10, 1, 2.0).empty ());
+    VERIFY (search::get_rungs (10, 0, 1, 2.0).empty ());
+
+    bool failed = false;
+    try { search::get_rungs (10, 10, 1, 1.0); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_successive_halving ()
+{
+    // Configuration 'i' scores 'i' on every file, except that 13 is
+    // the best on the first file and the worst after that
+    const size_t n = 27;
+    const size_t total_files = 30;
+    vector<double> sum (n);
+    vector<size_t> files (n);
+    vector<size_t> evaluated (n);
+
+    const auto evaluate = [&](const vector<size_t> &indexes, const size_t first, const size_t last)
+    {
+        for (auto i : indexes)
+        {
+            VERIFY (files[i] == first);
+            for (size_t j = first; j < last; ++j)
+                sum[i] += (i != 13) ? i : (j == 0 ? 30.0 : 0.0);
+            files[i] = last;
+            evaluated[i] += last - first;
+        }
+    };
+    const auto score = [&](const size_t i) { return sum[i] / files[i]; };
+
+    const auto rungs = search::get_rungs (n, total_files, 1, 3.0);
+    const auto best = search::successive_halving (rungs, evaluate, score);
+
+    VERIFY (best.size () == rungs.back ().configs);
+    VERIFY (best[0] == 26);
+    VERIFY (is_sorted (best.begin (), best.end (), greater<size_t> ()));
+    VERIFY (find (best.begin (), best.end (), 13) == best.end ());
+
+    // The survivors were evaluated on all of the files
+    for (auto i : best)
+        VERIFY (files[i] == total_files);
+
+    // Poor configurations were dropped early
+    size_t cost = 0;
+    for (auto i : evaluated)
+        cost += i;
+    VERIFY (cost < n * total_files / 3);
+    VERIFY (evaluated[0] == rungs[0].files);
+
+    // Configurations that went further rank higher
+    const vector<double> s { 0.9, 0.1, 0.5 };
+    VERIFY (search::get_ranking (s, { 1, 10, 10 }) == vector<size_t> ({ 2, 1, 0 }));
+}
+
+int main ()
+{
+    try
+    {
+        test_get_dimension ();
+        test_get_grid ();
+        test_get_value ();
+        test_samples ();
+        test_scores ();
+        test_get_ranking ();
+        test_get_rungs ();
+        test_successive_halving ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
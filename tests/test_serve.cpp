@@ -0,0 +1,308 @@
+#include "oopp/precompiled.h"
+#include "oopp/serve.h"
+#include "oopp/synthetic.h"
+#include "oopp/verify.h"
+
+#include <thread>
+
+using namespace std;
+using namespace oopp;
+
+// Get a synthetic track, with a different seed each time
+vector<photon> get_photons (const size_t total)
+{
+    static uint64_t seed = 0;
+    synthetic::track_params t;
+    t.length = total / t.density;
+    t.land_gaps = 0;
+    t.seed = seed++;
+    return synthetic::get_track (t);
+}
+
+// Both ends of a connected socket pair
+struct connection
+{
+    int client = -1;
+    int server = -1;
+    connection ()
+    {
+        int fds[2];
+        if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            throw runtime_error ("Could not create a socket pair");
+        client = fds[0];
+        server = fds[1];
+    }
+    ~connection ()
+    {
+        close_client ();
+        if (server != -1)
+            ::close (server);
+    }
+    void close_client ()
+    {
+        if (client != -1)
+            ::close (client);
+        client = -1;
+    }
+};
+
+void test_frames ()
+{
+    connection c;
+
+    serve::write_frame (c.client, serve::BINARY, "abc");
+    serve::write_frame (c.client, serve::CSV, "");
+
+    serve::frame f;
+    VERIFY (serve::read_frame (c.server, f));
+    VERIFY (f.type == serve::BINARY);
+    VERIFY (f.payload == "abc");
+    VERIFY (serve::read_frame (c.server, f));
+    VERIFY (f.type == serve::CSV);
+    VERIFY (f.payload.empty ());
+
+    // A stream that ends between frames is not an error
+    c.close_client ();
+    VERIFY (!serve::read_frame (c.server, f));
+}
+
+void test_truncated_frame ()
+{
+    connection c;
+
+    // The header promises more than is sent
+    std::string s;
+    serve::detail::append (s, serve::CSV);
+    serve::detail::append (s, uint64_t (100));
+    s += "abc";
+    serve::detail::write_all (c.client, s.data (), s.size ());
+    c.close_client ();
+
+    serve::frame f;
+    bool failed = false;
+    try { serve::read_frame (c.server, f); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_frame_size ()
+{
+    // A header that promises the largest allowed frame only
+    // allocates what is sent
+    {
+        connection c;
+        std::string s;
+        serve::detail::append (s, serve::CSV);
+        serve::detail::append (s, serve::MAX_PAYLOAD);
+        s += "abc";
+        serve::detail::write_all (c.client, s.data (), s.size ());
+        c.close_client ();
+
+        serve::frame f;
+        bool failed = false;
+        try { serve::read_frame (c.server, f); }
+        catch (const exception &e) { failed = string (e.what ()) == "Frame is truncated"; }
+        VERIFY (failed);
+        VERIFY (f.payload.capacity () <= (2 << 20));
+    }
+
+    // Larger frames are rejected before their payload is read
+    {
+        connection c;
+        serve::write_frame (c.client, serve::CSV, "abcd");
+        serve::write_frame (c.client, serve::CSV, "abc");
+
+        serve::frame f;
+        bool failed = false;
+        try { serve::read_frame (c.server, f, 3); }
+        catch (const exception &e) { failed = string (e.what ()) == "Frame is too large"; }
+        VERIFY (failed);
+    }
+
+    // Payloads that span several chunks are read whole
+    {
+        connection c;
+        std::string payload (3'000'000, ' ');
+        for (size_t i = 0; i < payload.size (); ++i)
+            payload[i] = 'a' + i % 26;
+        thread client ([&] { serve::write_frame (c.client, serve::BINARY, payload); });
+
+        serve::frame f;
+        VERIFY (serve::read_frame (c.server, f));
+        client.join ();
+        VERIFY (f.payload == payload);
+    }
+}
+
+void test_encoding ()
+{
+    const auto p = classify (get_photons (1000), params ());
+
+    const auto q = serve::decode_photons (serve::encode_photons (p));
+    VERIFY (q.size () == p.size ());
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        VERIFY (q[i].h5_index == p[i].h5_index);
+        VERIFY (q[i].x == p[i].x);
+        VERIFY (q[i].z == p[i].z);
+    }
+
+    auto r = q;
+    serve::decode_predictions (serve::encode_predictions (p), r);
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        VERIFY (r[i].prediction == p[i].prediction);
+        VERIFY (r[i].surface_elevation == p[i].surface_elevation);
+        VERIFY (r[i].bathy_elevation == p[i].bathy_elevation);
+    }
+
+    // Payloads with the wrong size are rejected
+    auto s = serve::encode_photons (p);
+    s.pop_back ();
+    bool failed = false;
+    try { serve::decode_photons (s); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+
+    r.pop_back ();
+    failed = false;
+    try { serve::decode_predictions (serve::encode_predictions (p), r); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_serve ()
+{
+    const params a;
+    const auto p = get_photons (10'000);
+    const auto expected = classify (p, a);
+
+    // Make sure the test is not trivial
+    VERIFY (any_of (expected.begin (), expected.end (), [](const auto &i) { return i.prediction == bathy_class; }));
+
+    // Write the track as a classify input file
+    ostringstream csv;
+    csv << "index_ph,x_atc,geoid_corr_h,manual_label" << endl;
+    csv << setprecision (16);
+    for (const auto &i : p)
+        csv << i.h5_index << "," << i.x << "," << i.z << "," << i.cls << endl;
+
+    const vector<serve::frame> requests {
+        { serve::BINARY, serve::encode_photons (p) },
+        { serve::CSV, csv.str () },
+        { serve::CSV, "garbage\n" },
+        { serve::BINARY, serve::encode_photons (vector<photon> ()) },
+        { 99, "" },
+        { serve::BINARY, serve::encode_photons (p) },
+    };
+
+    // Requests and responses are larger than the socket buffers, so
+    // the client writes, the server answers, and this thread reads
+    connection c;
+    size_t answered = 0;
+    thread server ([&] { answered = serve::serve (c.server, c.server, [&](auto &q) { q = classify (q, a); }); });
+    thread client ([&]
+    {
+        for (const auto &i : requests)
+            serve::write_frame (c.client, i.type, i.payload);
+        shutdown (c.client, SHUT_WR);
+    });
+
+    vector<serve::frame> responses;
+    serve::frame f;
+    while (responses.size () < requests.size () && serve::read_frame (c.client, f))
+        responses.push_back (f);
+
+    client.join ();
+    server.join ();
+    VERIFY (answered == requests.size ());
+    VERIFY (responses.size () == requests.size ());
+
+    // Binary
+    for (auto i : { 0, 5 })
+    {
+        VERIFY (responses[i].type == serve::BINARY);
+        auto q = p;
+        serve::decode_predictions (responses[i].payload, q);
+        for (size_t j = 0; j < q.size (); ++j)
+        {
+            VERIFY (q[j].prediction == expected[j].prediction);
+            VERIFY (q[j].surface_elevation == expected[j].surface_elevation);
+            VERIFY (q[j].bathy_elevation == expected[j].bathy_elevation);
+        }
+    }
+
+    // CSV
+    VERIFY (responses[1].type == serve::CSV);
+    ostringstream os;
+    write_predictions (os, expected);
+    VERIFY (responses[1].payload == os.str ());
+
+    // Errors don't stop the server
+    for (auto i : { 2, 3, 4 })
+    {
+        VERIFY (responses[i].type == serve::ERROR);
+        VERIFY (!responses[i].payload.empty ());
+    }
+}
+
+void test_timeout ()
+{
+    // The client stalls in the middle of a frame
+    connection c;
+    std::string s;
+    serve::detail::append (s, serve::CSV);
+    serve::detail::append (s, uint64_t (100));
+    s += "abc";
+    serve::detail::write_all (c.client, s.data (), s.size ());
+
+    serve::set_timeout (c.server, 0.1);
+    bool failed = false;
+    try { serve::serve (c.server, c.server, [](auto &) { }); }
+    catch (const exception &e) { failed = string (e.what ()) == "Timed out reading frame"; }
+    VERIFY (failed);
+}
+
+void test_listen ()
+{
+    const auto path = filesystem::temp_directory_path () / ("test_serve_" + to_string (getpid ()));
+    filesystem::remove (path);
+
+    // A stale socket is replaced
+    ::close (serve::listen (path.string ()));
+    VERIFY (filesystem::is_socket (path));
+    const int fd = serve::listen (path.string ());
+    ::close (serve::connect (path.string ()));
+    ::close (fd);
+    filesystem::remove (path);
+
+    // Anything else is not
+    ofstream (path) << "x";
+    bool failed = false;
+    try { serve::listen (path.string ()); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+    VERIFY (filesystem::is_regular_file (path));
+    filesystem::remove (path);
+}
+
+int main ()
+{
+    try
+    {
+        test_frames ();
+        test_truncated_frame ();
+        test_frame_size ();
+        test_encoding ();
+        test_serve ();
+        test_timeout ();
+        test_listen ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
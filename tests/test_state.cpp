@@ -0,0 +1,159 @@
+#include "oopp/precompiled.h"
+#include "oopp/state.h"
+#include "oopp/synthetic.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+mt19937 rng(12345);
+
+// Get a synthetic track, with noise outside of the histogram, in random
+// order
+vector<photon> get_photons (const size_t total)
+{
+    static uint64_t seed = 0;
+    synthetic::track_params t;
+    t.length = total / t.density;
+    t.land_gaps = 0;
+    t.noise_fraction = 0.3;
+    t.noise_z_min = -60.0;
+    t.noise_z_max = 40.0;
+    t.seed = seed++;
+    auto p = synthetic::get_track (t);
+    shuffle (p.begin (), p.end (), rng);
+    return p;
+}
+
+void test_state (const size_t n)
+{
+    const auto p = get_photons (n);
+    const params a;
+    const auto t = state::get_track (p, a);
+
+    // Change only the thresholds
+    for (auto surface_n_stddev : { 1.0, 2.0, 3.5 })
+    {
+        for (auto bathy_n_stddev : { 1.5, 3.0, 6.0 })
+        {
+            for (auto min_photons : { 0, 3, 15 })
+            {
+                params b;
+                b.surface_n_stddev = surface_n_stddev;
+                b.bathy_n_stddev = bathy_n_stddev;
+                b.min_surface_photons_per_window = min_photons;
+                b.min_bathy_photons_per_window = min_photons;
+
+                // It should give the same answer as a full classification
+                const auto q = classify (p, b);
+                const auto r = state::classify (p, t, b);
+                VERIFY (q == r);
+            }
+        }
+    }
+
+    // The state depends on the binning
+    params c;
+    c.z_resolution = 0.1;
+    bool failed = false;
+    try { state::classify (p, t, c); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+void test_read_write ()
+{
+    const auto p = get_photons (5'000);
+    const params a;
+    const auto t = state::get_track (p, a);
+
+    stringstream ss;
+    state::write (ss, t);
+    const auto u = state::read (ss);
+
+    VERIFY (state::is_compatible (u, p, a));
+    VERIFY (u.photons_hash == t.photons_hash);
+    VERIFY (u.windows.size () == t.windows.size ());
+    VERIFY (state::classify (p, t, a) == state::classify (p, u, a));
+
+    // Garbage should not be accepted
+    stringstream bad ("not a state file");
+    bool failed = false;
+    try { state::read (bad); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+
+    // Neither should a truncated file
+    const auto s = ss.str ();
+    stringstream truncated (s.substr (0, s.size () / 2));
+    failed = false;
+    try { state::read (truncated); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+
+    // Or state that refers to photons or bins that don't exist
+    size_t w = 0;
+    while (t.windows[w].indexes.empty () || t.windows[w].peaks.empty ())
+        ++w;
+    const auto total_bins = t.windows[w].offsets.size () - 1;
+    const vector<function<void(state::track &)>> damage {
+        [&](auto &x) { x.windows[w].offsets.pop_back (); },
+        [&](auto &x) { x.windows[w].offsets.back () -= 1; },
+        [&](auto &x) { x.windows[w].offsets[1] = x.windows[w].offsets[2] + 1; },
+        [&](auto &x) { x.windows[w].indexes[0] = p.size (); },
+        [&](auto &x) { x.windows[w].peaks[0].bin = total_bins; },
+        [&](auto &x) { x.windows[w].offsets.clear (); },
+        [&](auto &x) { x.z_resolution = 0.0; },
+    };
+    for (const auto &f : damage)
+    {
+        auto x = t;
+        f (x);
+        stringstream damaged;
+        state::write (damaged, x);
+        failed = false;
+        try { state::read (damaged); }
+        catch (const exception &e) { failed = string (e.what ()) == "Invalid state file"; }
+        VERIFY (failed);
+    }
+}
+
+void test_other_photons ()
+{
+    const auto p = get_photons (5'000);
+    const params a;
+    const auto t = state::get_track (p, a);
+    VERIFY (state::is_compatible (t, p, a));
+
+    // Another track with the same number of photons
+    const auto q = get_photons (p.size ());
+    VERIFY (!state::is_compatible (t, q, a));
+
+    // Or the same track with one photon moved
+    auto r = p;
+    r[r.size () / 2].z += 0.01;
+    VERIFY (!state::is_compatible (t, r, a));
+
+    bool failed = false;
+    try { state::classify (r, t, a); }
+    catch (...) { failed = true; }
+    VERIFY (failed);
+}
+
+int main ()
+{
+    try
+    {
+        test_state (10);
+        test_state (20'000);
+        test_read_write ();
+        test_other_photons ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
@@ -0,0 +1,160 @@
+#include "oopp/precompiled.h"
+#include "oopp/sweep.h"
+#include "oopp/synthetic.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+mt19937 rng(12345);
+
+// Get a labeled synthetic track in random order
+vector<photon> get_labeled_photons (const size_t total)
+{
+    static uint64_t seed = 0;
+    synthetic::track_params t;
+    t.length = total / t.density;
+    t.land_gaps = 0;
+    t.seed = seed++;
+    auto p = synthetic::get_track (t);
+    shuffle (p.begin (), p.end (), rng);
+    return p;
+}
+
+void test_group_by_binning ()
+{
+    vector<params> p (4);
+    p[1].surface_n_stddev = 2.0;
+    p[2].x_resolution = 5.0;
+    p[3].z_resolution = 0.1;
+    const auto g = sweep::group_by_binning (p);
+    VERIFY (g.size () == 3);
+    VERIFY (g.at (sweep::get_binning (p[0])).size () == 2);
+    VERIFY (g.at (sweep::get_binning (p[2])).size () == 1);
+}
+
+void verify_equal (const scoring::confusion_matrices &a, const scoring::confusion_matrices &b)
+{
+    VERIFY (a.size () == b.size ());
+    for (const auto &j : b)
+    {
+        const auto &x = a.at (j.first);
+        const auto &y = j.second;
+        VERIFY (x.true_positives () == y.true_positives ());
+        VERIFY (x.true_negatives () == y.true_negatives ());
+        VERIFY (x.false_positives () == y.false_positives ());
+        VERIFY (x.false_negatives () == y.false_negatives ());
+    }
+}
+
+void test_sweep (const size_t n, const long cls, const long ignore_cls)
+{
+    const vector<vector<photon>> tracks {
+        get_labeled_photons (n),
+        get_labeled_photons (n / 2),
+    };
+
+    // Parameter sets with two different binnings
+    vector<params> p;
+    for (auto x_resolution : { 10.0, 20.0 })
+    {
+        for (auto surface_n_stddev : { 2.0, 3.5 })
+        {
+            for (auto min_bathy_photons_per_window : { 3, 20 })
+            {
+                params a;
+                a.x_resolution = x_resolution;
+                a.surface_n_stddev = surface_n_stddev;
+                a.min_bathy_photons_per_window = min_bathy_photons_per_window;
+                p.push_back (a);
+            }
+        }
+    }
+
+    const auto classes = scoring::get_classes (cls);
+    const auto cms = sweep::sweep (tracks, p, classes, ignore_cls);
+    VERIFY (cms.size () == p.size ());
+
+    // It should give the same answer as classifying and scoring
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        auto expected = scoring::get_confusion_matrices (classes);
+        for (const auto &t : tracks)
+        {
+            const auto q = classify (t, p[i]);
+            scoring::add (expected, scoring::get_confusion_matrices (q, classes, ignore_cls));
+        }
+
+        verify_equal (cms[i], expected);
+    }
+
+    // Make sure the test is not trivial
+    VERIFY (cms[0].begin ()->second.true_positives () != 0);
+}
+
+void test_sweep_range ()
+{
+    // Tracks of different lengths, so that the order matters
+    vector<vector<photon>> tracks;
+    for (auto length : { 1000.0, 3000.0, 500.0, 2000.0 })
+    {
+        synthetic::track_params t;
+        t.length = length;
+        t.seed = tracks.size ();
+        tracks.push_back (synthetic::get_track (t));
+    }
+
+    vector<params> p (2);
+    p[1].x_resolution = 20.0;
+
+    const auto classes = scoring::get_classes (-1);
+    const auto all = sweep::sweep (tracks, p, classes, -1);
+
+    // Two disjoint ranges should add up to all of the tracks
+    auto cms = sweep::sweep (tracks, 0, 1, p, classes, -1);
+    const auto rest = sweep::sweep (tracks, 1, tracks.size (), p, classes, -1);
+    VERIFY (cms.size () == p.size ());
+    VERIFY (rest.size () == p.size ());
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        scoring::add (cms[i], rest[i]);
+        verify_equal (cms[i], all[i]);
+    }
+
+    // A range in the middle should only score its own tracks
+    const auto middle = sweep::sweep (tracks, 1, 3, p, classes, -1);
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        auto expected = scoring::get_confusion_matrices (classes);
+        for (size_t j = 1; j < 3; ++j)
+            scoring::add (expected, scoring::get_confusion_matrices (classify (tracks[j], p[i]), classes, -1));
+        verify_equal (middle[i], expected);
+    }
+
+    // An empty range scores nothing
+    const auto none = sweep::sweep (tracks, 2, 2, p, classes, -1);
+    for (size_t i = 0; i < p.size (); ++i)
+        verify_equal (none[i], scoring::get_confusion_matrices (classes));
+
+    // Make sure the test is not trivial
+    VERIFY (all[0].begin ()->second.true_positives () != 0);
+}
+
+int main ()
+{
+    try
+    {
+        test_group_by_binning ();
+        test_sweep (10, -1, -1);
+        test_sweep (10'000, -1, -1);
+        test_sweep (10'000, 40, 41);
+        test_sweep_range ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
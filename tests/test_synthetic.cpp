@@ -0,0 +1,63 @@
+#include "oopp/precompiled.h"
+#include "oopp/scoring.h"
+#include "oopp/synthetic.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+void test_track (const size_t seed)
+{
+    synthetic::track_params tp;
+    tp.length = 5'000.0;
+    tp.seed = seed;
+    const auto p = synthetic::get_track (tp);
+
+    VERIFY (p.size () == 50'000);
+
+    // Sorted by along-track distance, within the track
+    for (size_t i = 0; i < p.size (); ++i)
+    {
+        VERIFY (p[i].h5_index == i);
+        VERIFY (p[i].x >= 0.0 && p[i].x <= tp.length);
+        if (i != 0)
+            VERIFY (p[i - 1].x <= p[i].x);
+    }
+
+    // All kinds of returns are present
+    size_t surface = 0;
+    size_t bathy = 0;
+    for (const auto &i : p)
+    {
+        surface += i.cls == sea_surface_class;
+        bathy += i.cls == bathy_class;
+    }
+    VERIFY (surface > p.size () / 4);
+    VERIFY (bathy > p.size () / 20);
+    VERIFY (surface + bathy < p.size ());
+
+    // Reproducible
+    VERIFY (p == synthetic::get_track (tp));
+
+    // The classifier should do well on it
+    const auto q = classify (p, params ());
+    const auto cms = scoring::get_confusion_matrices (q, scoring::get_classes (-1), -1);
+    VERIFY (cms.at (sea_surface_class).F1 () > 0.9);
+    VERIFY (cms.at (bathy_class).F1 () > 0.8);
+}
+
+int main ()
+{
+    try
+    {
+        test_track (0);
+        test_track (1);
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}
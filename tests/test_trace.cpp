@@ -0,0 +1,94 @@
+// Record spans in this test, whether or not the build does
+#ifndef OOPP_TRACE
+#define OOPP_TRACE
+#endif
+
+#include "oopp/precompiled.h"
+#include "oopp/trace.h"
+#include "oopp/verify.h"
+
+using namespace std;
+using namespace oopp;
+
+void test_spans ()
+{
+    VERIFY (trace::enabled ());
+
+    const size_t n0 = trace::size ();
+    {
+        OOPP_TRACE_SPAN ("outer");
+        {
+            OOPP_TRACE_SPAN ("inner");
+        }
+    }
+    VERIFY (trace::size () == n0 + 2);
+
+    const size_t threads = 4;
+    const size_t n = 100;
+#pragma omp parallel for num_threads(threads)
+    for (size_t i = 0; i < n; ++i)
+    {
+        OOPP_TRACE_SPAN ("parallel");
+    }
+    VERIFY (trace::size () == n0 + 2 + n);
+}
+
+void test_chrome_trace ()
+{
+    stringstream ss;
+    trace::write_chrome_trace (ss);
+    const string s = ss.str ();
+
+    VERIFY (s.starts_with ("{\"traceEvents\":["));
+    VERIFY (s.find ("\"name\":\"outer\"") != string::npos);
+    VERIFY (s.find ("\"name\":\"inner\"") != string::npos);
+    VERIFY (s.find ("\"name\":\"parallel\"") != string::npos);
+
+    // One complete event per span
+    size_t events = 0;
+    for (size_t i = s.find ("\"ph\":\"X\""); i != string::npos; i = s.find ("\"ph\":\"X\"", i + 1))
+        ++events;
+    VERIFY (events == trace::size ());
+
+    // Braces and brackets are balanced
+    VERIFY (count (s.begin (), s.end (), '{') == count (s.begin (), s.end (), '}'));
+    VERIFY (count (s.begin (), s.end (), '[') == count (s.begin (), s.end (), ']'));
+}
+
+void test_nesting ()
+{
+    // Spans are recorded when they end, so the inner one comes first
+    trace::detail::buffer &b = trace::detail::get_buffer ();
+    const size_t n0 = b.events.size ();
+    {
+        OOPP_TRACE_SPAN ("outer");
+        {
+            OOPP_TRACE_SPAN ("inner");
+        }
+    }
+    VERIFY (b.events.size () == n0 + 2);
+    const auto &inner = b.events[n0];
+    const auto &outer = b.events[n0 + 1];
+    VERIFY (string (inner.name) == "inner");
+    VERIFY (string (outer.name) == "outer");
+    VERIFY (outer.begin <= inner.begin);
+    VERIFY (inner.begin <= inner.end);
+    VERIFY (inner.end <= outer.end);
+}
+
+int main ()
+{
+    try
+    {
+        test_spans ();
+        test_chrome_trace ();
+        test_nesting ();
+
+        return 0;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what () << endl;
+        return -1;
+    }
+}